@@ -0,0 +1,722 @@
+// Throughput and accuracy of Convert and Playback on synthetic frames, without a VapourSynth core.
+// Results are printed as JSON, to be compared between builds.
+
+#include "half.hpp"
+#include "iccc.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+struct benchFormat
+{
+    const char *name;
+    int sampleType;
+    int bitsPerSample;
+};
+
+static const benchFormat benchFormats[] = {
+    {"RGB24", stInteger, 8},
+    {"RGB30", stInteger, 10},
+    {"RGB48", stInteger, 16},
+    {"RGBS", stFloat, 32},
+    {"RGBH", stFloat, 16},
+};
+
+struct benchSize
+{
+    const char *name;
+    int width;
+    int height;
+};
+
+static const benchSize benchSizes[] = {
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+    {"8k", 7680, 4320},
+};
+
+static const char * const benchConfigs[] = {
+    "convert_preset", // input and display profiles by preset name
+    "convert_file", // the same profiles read from files
+    "convert_props", // input profile embedded in every frame
+    "playback", // BT.1886 input and a display profile file
+};
+
+struct benchOptions
+{
+    bool accuracy = false;
+    int frames = 10;
+    int threads = 1;
+    const char *engine = nullptr;
+    const char *layout = nullptr;
+    std::vector<std::string> formats = {"RGB24", "RGB48", "RGBS"};
+    std::vector<std::string> sizes = {"1080p", "4k", "8k"};
+    std::vector<std::string> configs = {"convert_preset", "convert_file", "convert_props", "playback"};
+    std::vector<int> clutSizes = {-1, 0, 1};
+    const char *output = nullptr;
+};
+
+// Profiles written to the working directory for the run
+struct benchProfiles
+{
+    std::string input = "iccc_bench_input.icc";
+    std::string display = "iccc_bench_display.icc";
+    // Sampled into CLUTs in both directions, from sRGB and from the display above
+    std::string lutInput = "iccc_bench_lut_input.icc";
+    std::string lutDisplay = "iccc_bench_lut_display.icc";
+    std::vector<char> inputBlob;
+
+    ~benchProfiles()
+    {
+        for (auto *path : {&input, &display, &lutInput, &lutDisplay})
+            std::remove(path->c_str());
+    }
+};
+
+// Planes of one frame in a single allocation, evenly spaced like VapourSynth allocates them
+struct benchFrame
+{
+    std::vector<uint8_t> data;
+    ptrdiff_t stride = 0;
+    uint8_t *planes[3] = {};
+
+    benchFrame(int width, int height, int bytesPerSample)
+    {
+        stride = (static_cast<ptrdiff_t>(width) * bytesPerSample + 63) & ~static_cast<ptrdiff_t>(63);
+        data.resize(stride * height * 3 + 64);
+        uint8_t *base = data.data() + (64 - reinterpret_cast<uintptr_t>(data.data()) % 64) % 64;
+        for (int p = 0; p < 3; ++p)
+            planes[p] = base + stride * height * p;
+    }
+};
+
+static int getBytesPerSample(const benchFormat &format)
+{
+    return (format.bitsPerSample + 7) / 8;
+}
+
+static VSVideoInfo getVideoInfo(const benchFormat &format, int width, int height, int numFrames)
+{
+    VSVideoInfo vi = {};
+    vi.format.colorFamily = cfRGB;
+    vi.format.sampleType = format.sampleType;
+    vi.format.bitsPerSample = format.bitsPerSample;
+    vi.format.bytesPerSample = getBytesPerSample(format);
+    vi.format.numPlanes = 3;
+    vi.width = width;
+    vi.height = height;
+    vi.numFrames = numFrames;
+    vi.fpsNum = 24;
+    vi.fpsDen = 1;
+    return vi;
+}
+
+static framePlanes getFramePlanes(const benchFrame &src, benchFrame &dst, int width, int height)
+{
+    framePlanes frame;
+    for (int p = 0; p < 3; ++p)
+    {
+        frame.src[p] = src.planes[p];
+        frame.dst[p] = dst.planes[p];
+    }
+    frame.srcStride = src.stride;
+    frame.dstStride = dst.stride;
+    frame.width = width;
+    frame.height = height;
+    return frame;
+}
+
+static void setSample(uint8_t *row, int x, double v, const benchFormat &format)
+{
+    if (format.sampleType == stFloat && format.bitsPerSample == 16)
+        reinterpret_cast<uint16_t *>(row)[x] = floatToHalf(static_cast<float>(v));
+    else if (format.sampleType == stFloat)
+        reinterpret_cast<float *>(row)[x] = static_cast<float>(v);
+    else if (format.bitsPerSample > 8)
+        reinterpret_cast<uint16_t *>(row)[x] = static_cast<uint16_t>(v * ((1 << format.bitsPerSample) - 1) + 0.5);
+    else
+        row[x] = static_cast<uint8_t>(v * 255.0 + 0.5);
+}
+
+static double getSample(const uint8_t *row, int x, const benchFormat &format)
+{
+    if (format.sampleType == stFloat && format.bitsPerSample == 16)
+        return halfToFloat(reinterpret_cast<const uint16_t *>(row)[x]);
+    else if (format.sampleType == stFloat)
+        return reinterpret_cast<const float *>(row)[x];
+    else if (format.bitsPerSample > 8)
+        return reinterpret_cast<const uint16_t *>(row)[x] / double((1 << format.bitsPerSample) - 1);
+    else
+        return row[x] / 255.0;
+}
+
+// Gradients with some noise, so that neither caches nor branches see a flat picture
+static void fillFrame(benchFrame &frame, int width, int height, const benchFormat &format)
+{
+    uint32_t seed = 12345;
+    for (int p = 0; p < 3; ++p)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            uint8_t *row = frame.planes[p] + frame.stride * y;
+            for (int x = 0; x < width; ++x)
+            {
+                seed = seed * 1664525 + 1013904223;
+                double v = (p == 0 ? x / double(width) : p == 1 ? y / double(height) : (x + y) / double(width + height));
+                setSample(row, x, std::min(std::max(v + ((seed >> 24) / 255.0 - 0.5) / 16.0, 0.0), 1.0), format);
+            }
+        }
+    }
+}
+
+static bool saveProfile(cmsHPROFILE profile, const std::string &path, std::vector<char> *blob)
+{
+    if (!profile) return false;
+    bool saved = cmsSaveProfileToFile(profile, path.c_str());
+    cmsUInt32Number size = 0;
+    if (saved && blob && cmsSaveProfileToMem(profile, nullptr, &size))
+    {
+        blob->resize(size);
+        saved = cmsSaveProfileToMem(profile, blob->data(), &size);
+    }
+    cmsCloseProfile(profile);
+    return saved;
+}
+
+// A wide gamut display with a plain 2.2 gamma
+static cmsHPROFILE createDisplayProfile()
+{
+    cmsCIExyY wp = csp_2020.white();
+    cmsCIExyYTRIPLE prim = csp_2020.prim();
+    cmsToneCurve *curve = cmsBuildGamma(nullptr, 2.2);
+    cmsToneCurve *curves[3] = {curve, curve, curve};
+    cmsHPROFILE profile = cmsCreateRGBProfile(&wp, &prim, curves);
+    cmsFreeToneCurve(curve);
+    return profile;
+}
+
+static cmsInt32Number sampleTransform(const cmsUInt16Number in[], cmsUInt16Number out[], void *cargo)
+{
+    cmsDoTransform(static_cast<cmsHTRANSFORM>(cargo), in, out, 1);
+    return TRUE;
+}
+
+// A display profile with 17 point CLUTs between RGB and Lab, sampled from a matrix/TRC one
+static cmsHPROFILE createLutProfile(cmsHPROFILE base)
+{
+    cmsHPROFILE lab = cmsCreateLab4Profile(nullptr);
+    cmsHTRANSFORM toLab = cmsCreateTransform(base, TYPE_RGB_16, lab, TYPE_Lab_16, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE);
+    cmsHTRANSFORM fromLab = cmsCreateTransform(lab, TYPE_Lab_16, base, TYPE_RGB_16, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE);
+    cmsCloseProfile(lab);
+
+    // Stored as identity curves, a CLUT and identity curves again, which both tag types can hold
+    cmsHPROFILE profile = nullptr;
+    cmsPipeline *pipelines[2] = {cmsPipelineAlloc(nullptr, 3, 3), cmsPipelineAlloc(nullptr, 3, 3)};
+    cmsHTRANSFORM samplers[2] = {toLab, fromLab};
+    bool built = toLab && fromLab;
+    for (int i = 0; i < 2 && built; ++i)
+    {
+        cmsStage *clut = cmsStageAllocCLut16bit(nullptr, 17, 3, 3, nullptr);
+        built = pipelines[i] && clut && cmsStageSampleCLut16bit(clut, sampleTransform, samplers[i], 0)
+            && cmsPipelineInsertStage(pipelines[i], cmsAT_END, cmsStageAllocToneCurves(nullptr, 3, nullptr))
+            && cmsPipelineInsertStage(pipelines[i], cmsAT_END, clut)
+            && cmsPipelineInsertStage(pipelines[i], cmsAT_END, cmsStageAllocToneCurves(nullptr, 3, nullptr));
+        if (!built && clut) cmsStageFree(clut);
+    }
+    if (built)
+    {
+        profile = cmsCreateProfilePlaceholder(nullptr);
+        cmsSetProfileVersion(profile, 4.3);
+        cmsSetDeviceClass(profile, cmsSigDisplayClass);
+        cmsSetColorSpace(profile, cmsSigRgbData);
+        cmsSetPCS(profile, cmsSigLabData);
+        cmsSetHeaderRenderingIntent(profile, INTENT_RELATIVE_COLORIMETRIC);
+        if (!cmsWriteTag(profile, cmsSigMediaWhitePointTag, cmsD50_XYZ()) || !cmsWriteTag(profile, cmsSigAToB0Tag, pipelines[0]) || !cmsWriteTag(profile, cmsSigBToA0Tag, pipelines[1]))
+        {
+            cmsCloseProfile(profile);
+            profile = nullptr;
+        }
+    }
+
+    for (auto *pipeline : pipelines)
+        if (pipeline) cmsPipelineFree(pipeline);
+    if (toLab) cmsDeleteTransform(toLab);
+    if (fromLab) cmsDeleteTransform(fromLab);
+    return profile;
+}
+
+static bool writeProfiles(benchProfiles &profiles, bool lut)
+{
+    if (!saveProfile(cmsCreate_sRGBProfile(), profiles.input, &profiles.inputBlob) || !saveProfile(createDisplayProfile(), profiles.display, nullptr))
+        return false;
+    if (!lut)
+        return true;
+
+    cmsHPROFILE srgb = cmsCreate_sRGBProfile();
+    cmsHPROFILE display = createDisplayProfile();
+    bool saved = saveProfile(createLutProfile(srgb), profiles.lutInput, nullptr) && saveProfile(createLutProfile(display), profiles.lutDisplay, nullptr);
+    cmsCloseProfile(srgb);
+    cmsCloseProfile(display);
+    return saved;
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+static std::vector<std::string> splitList(const char *list)
+{
+    std::vector<std::string> items;
+    std::string item;
+    for (const char *c = list; ; ++c)
+    {
+        if (*c == ',' || *c == '\0')
+        {
+            if (!item.empty()) items.push_back(item);
+            item.clear();
+            if (*c == '\0') break;
+        }
+        else
+            item += *c;
+    }
+    return items;
+}
+
+static bool contains(const std::vector<std::string> &list, const char *name)
+{
+    return std::find(list.begin(), list.end(), name) != list.end();
+}
+
+static void usage()
+{
+    fprintf(stderr,
+        "Usage: iccc_bench [options]\n"
+        "  --accuracy           compare the engines against Little CMS instead of timing them\n"
+        "  --frames N           timed frames per run (10)\n"
+        "  --threads N          threads option of the filters, 0 for all cores (1)\n"
+        "  --engine NAME        auto, lcms or lut (auto), all of them with --accuracy\n"
+        "  --layout NAME        auto, packed, planar or padded (auto), the interleave layout of Little CMS\n"
+        "  --formats LIST       RGB24,RGB30,RGB48,RGBS,RGBH\n"
+        "  --sizes LIST         1080p,4k,8k\n"
+        "  --configs LIST       convert_preset,convert_file,convert_props,playback\n"
+        "  --clut-sizes LIST    -1,0,1\n"
+        "  --output FILE        write the JSON there instead of stdout\n");
+}
+
+static bool parseOptions(int argc, char **argv, benchOptions &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--accuracy")
+        {
+            options.accuracy = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+        const char *value = argv[++i];
+        if (arg == "--frames")
+            options.frames = std::max(atoi(value), 1);
+        else if (arg == "--threads")
+            options.threads = atoi(value);
+        else if (arg == "--engine")
+            options.engine = value;
+        else if (arg == "--layout")
+            options.layout = value;
+        else if (arg == "--formats")
+            options.formats = splitList(value);
+        else if (arg == "--sizes")
+            options.sizes = splitList(value);
+        else if (arg == "--configs")
+            options.configs = splitList(value);
+        else if (arg == "--clut-sizes")
+        {
+            options.clutSizes.clear();
+            for (auto &item : splitList(value))
+                options.clutSizes.push_back(atoi(item.c_str()));
+        }
+        else if (arg == "--output")
+            options.output = value;
+        else
+            return false;
+    }
+    return true;
+}
+
+// Mpix/s and latency of every format, config, clut size and frame size. Returns false if any of them failed.
+static bool runThroughput(const benchOptions &options, const benchProfiles &profiles, int coreThreads, FILE *out)
+{
+    bool failed = false;
+    fprintf(out, "{\n  \"version\": \"%d.%d\",\n  \"threads\": %d,\n  \"core_threads\": %d,\n  \"frames\": %d,\n  \"results\": [", ICCC_PLUGIN_VERSION >> 16, ICCC_PLUGIN_VERSION & 0xFFFF, options.threads, coreThreads, options.frames);
+    const char *separator = "\n";
+
+    for (const auto &format : benchFormats)
+    {
+        if (!contains(options.formats, format.name)) continue;
+        for (const char *config : benchConfigs)
+        {
+            if (!contains(options.configs, config)) continue;
+            for (int clutSize : options.clutSizes)
+            {
+                for (const auto &size : benchSizes)
+                {
+                    if (!contains(options.sizes, size.name)) continue;
+
+                    VSVideoInfo vi = getVideoInfo(format, size.width, size.height, options.frames + 1);
+
+                    std::string error;
+                    std::vector<std::string> warnings;
+                    icccData *d = nullptr;
+                    std::string name = config;
+                    bool embedded = name == "convert_props";
+
+                    auto start = std::chrono::steady_clock::now();
+                    if (name == "playback")
+                    {
+                        playbackArgs args;
+                        args.csp = "709";
+                        args.displayIcc = profiles.display.c_str();
+                        args.clutSize = clutSize;
+                        args.threads = options.threads;
+                        args.engine = options.engine;
+                        args.layout = options.layout;
+                        d = createPlayback(vi, args, coreThreads, error, warnings);
+                    }
+                    else
+                    {
+                        convertArgs args;
+                        if (name == "convert_preset")
+                        {
+                            args.inputIcc = "srgb";
+                            args.displayIcc = "2020";
+                        }
+                        else
+                        {
+                            args.inputIcc = embedded ? nullptr : profiles.input.c_str();
+                            args.displayIcc = profiles.display.c_str();
+                        }
+                        args.intent = "relative";
+                        args.preferProps = embedded;
+                        args.clutSize = clutSize;
+                        args.threads = options.threads;
+                        args.engine = options.engine;
+                        args.layout = options.layout;
+                        d = createConvert(vi, args, coreThreads, error, warnings);
+                    }
+                    double createMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                    if (!d)
+                    {
+                        fprintf(stderr, "iccc_bench: %s %s clut_size=%d: %s\n", format.name, config, clutSize, error.c_str());
+                        failed = true;
+                        continue;
+                    }
+
+                    benchFrame src(size.width, size.height, vi.format.bytesPerSample);
+                    benchFrame dst(size.width, size.height, getOutputInfo(d).format.bytesPerSample);
+                    fillFrame(src, size.width, size.height, format);
+                    framePlanes frame = getFramePlanes(src, dst, size.width, size.height);
+                    const char *iccData = embedded ? profiles.inputBlob.data() : nullptr;
+                    size_t iccSize = embedded ? profiles.inputBlob.size() : 0;
+
+                    // The first frame also builds transforms for embedded profiles and touches every buffer
+                    std::vector<double> latencies;
+                    double firstMs = 0.0;
+                    for (int n = 0; n <= options.frames && error.empty(); ++n)
+                    {
+                        auto frameStart = std::chrono::steady_clock::now();
+                        if (!convertFrame(d, frame, iccData, iccSize, error))
+                            break;
+                        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+                        if (n == 0)
+                            firstMs = ms;
+                        else
+                            latencies.push_back(ms);
+                    }
+                    double buildMs = getStats(d).buildNs.load() / 1e6;
+                    const char *layout = getLayoutName(d);
+                    freeConvert(d);
+
+                    if (!error.empty())
+                    {
+                        fprintf(stderr, "iccc_bench: %s %s clut_size=%d %s: %s\n", format.name, config, clutSize, size.name, error.c_str());
+                        failed = true;
+                        continue;
+                    }
+
+                    double totalMs = 0.0;
+                    for (double ms : latencies)
+                        totalMs += ms;
+                    std::sort(latencies.begin(), latencies.end());
+                    double mpix = static_cast<double>(size.width) * size.height * latencies.size() / 1e6;
+
+                    fprintf(out, "%s    {\"format\": \"%s\", \"config\": \"%s\", \"clut_size\": %d, \"size\": \"%s\", \"width\": %d, \"height\": %d, "
+                        "\"layout\": \"%s\", \"create_ms\": %.3f, \"build_ms\": %.3f, \"first_frame_ms\": %.3f, \"mpix_per_s\": %.2f, "
+                        "\"latency_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}}",
+                        separator, format.name, config, clutSize, size.name, size.width, size.height, layout,
+                        createMs, buildMs, firstMs, totalMs > 0.0 ? mpix / totalMs * 1000.0 : 0.0,
+                        totalMs / latencies.size(), percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99), latencies.back());
+                    fflush(out);
+                    separator = ",\n";
+                }
+            }
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    return !failed;
+}
+
+// A pair of profiles converted by Convert, or by Playback from the BT.1886 profile of a color space
+struct accuracyPair
+{
+    const char *name;
+    const char *input;
+    const char *output;
+    const cspData *playback;
+};
+
+static const char * const accuracyEngines[] = {"lcms", "auto", "lut"};
+static const char * const simdLevelNames[] = {"none", "sse41", "avx2", "avx512"};
+
+// Input codes on a grid that doesn't line up with the CLUT nodes, one row of the frame per blue level
+constexpr int accuracySteps = 37;
+
+// Converts the grid with the given options and SIMD limit, false on failure
+static bool convertGrid(const accuracyPair &pair, const benchFormat &format, const char *engine, int clutSize, simdLevel level, const benchFrame &src, benchFrame &dst, std::string &error)
+{
+    const int width = accuracySteps * accuracySteps;
+    VSVideoInfo vi = getVideoInfo(format, width, accuracySteps, 1);
+    std::vector<std::string> warnings;
+    icccData *d;
+
+    simdLimit() = level;
+    if (pair.playback)
+    {
+        playbackArgs args;
+        args.csp = pair.input;
+        args.displayIcc = pair.output;
+        args.clutSize = clutSize;
+        args.engine = engine;
+        d = createPlayback(vi, args, 1, error, warnings);
+    }
+    else
+    {
+        convertArgs args;
+        args.inputIcc = pair.input;
+        args.displayIcc = pair.output;
+        args.intent = "relative";
+        args.preferProps = false;
+        args.clutSize = clutSize;
+        args.engine = engine;
+        d = createConvert(vi, args, 1, error, warnings);
+    }
+    simdLimit() = simdLevel::avx512;
+    if (!d)
+        return false;
+
+    framePlanes frame = getFramePlanes(src, dst, width, accuracySteps);
+    bool converted = convertFrame(d, frame, nullptr, 0, error);
+    freeConvert(d);
+    return converted;
+}
+
+static cmsHPROFILE openProfile(const char *name)
+{
+    std::vector<char> blob;
+    if (!readProfile(name, blob)) return nullptr;
+    return cmsOpenProfileFromMem(blob.data(), static_cast<cmsUInt32Number>(blob.size()));
+}
+
+// deltaE 2000 of every engine and clut size against the unoptimized float pipeline of Little CMS,
+// and whether the engines that promise the same results on every CPU give them with each SIMD level.
+// Returns false if any conversion failed or a promise was broken.
+static bool runAccuracy(const benchOptions &options, const benchProfiles &profiles, FILE *out)
+{
+    const accuracyPair pairs[] = {
+        {"srgb>2020", "srgb", "2020", nullptr},
+        {"709>srgb", "709", "srgb", nullptr},
+        {"170m>2020", "170m", "2020", nullptr},
+        {"2020>srgb", "2020", "srgb", nullptr},
+        {"srgb>xyz", "srgb", "xyz", nullptr},
+        {"srgb>display", profiles.input.c_str(), profiles.display.c_str(), nullptr},
+        {"lut_srgb>display", profiles.lutInput.c_str(), profiles.display.c_str(), nullptr},
+        {"srgb>lut_display", "srgb", profiles.lutDisplay.c_str(), nullptr},
+        {"1886_709>display", "709", profiles.display.c_str(), &csp_709},
+        {"1886_2020>display", "2020", profiles.display.c_str(), &csp_2020},
+    };
+
+    bool failed = false;
+    simdLevel cpuLevel = getSimdLevel();
+    fprintf(out, "{\n  \"version\": \"%d.%d\",\n  \"simd\": \"%s\",\n  \"grid\": %d,\n  \"results\": [", ICCC_PLUGIN_VERSION >> 16, ICCC_PLUGIN_VERSION & 0xFFFF, simdLevelNames[static_cast<int>(cpuLevel)], accuracySteps);
+    const char *separator = "\n";
+
+    const int width = accuracySteps * accuracySteps;
+    const int height = accuracySteps;
+    const int pixels = width * height;
+
+    cmsHPROFILE lab = cmsCreateLab4Profile(nullptr);
+
+    for (const auto &pair : pairs)
+    {
+        cmsHPROFILE output = openProfile(pair.output);
+        cmsHPROFILE input = pair.playback ? getPlaybackProfile(*pair.playback, -1.0, 0.0, output) : openProfile(pair.input);
+        cmsUInt32Number flags = cmsFLAGS_NOOPTIMIZE | (pair.playback ? cmsFLAGS_BLACKPOINTCOMPENSATION : 0);
+        cmsHTRANSFORM reference = input && output ? cmsCreateTransform(input, TYPE_RGB_DBL, output, TYPE_RGB_DBL, INTENT_RELATIVE_COLORIMETRIC, flags) : nullptr;
+        cmsHTRANSFORM toLab = output ? cmsCreateTransform(output, TYPE_RGB_DBL, lab, TYPE_Lab_DBL, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE) : nullptr;
+        if (input) cmsCloseProfile(input);
+        if (output) cmsCloseProfile(output);
+        if (!reference || !toLab)
+        {
+            fprintf(stderr, "iccc_bench: %s: Unable to create the reference transform.\n", pair.name);
+            failed = true;
+            if (reference) cmsDeleteTransform(reference);
+            if (toLab) cmsDeleteTransform(toLab);
+            continue;
+        }
+
+        for (const auto &format : benchFormats)
+        {
+            if (!contains(options.formats, format.name)) continue;
+
+            // Reference of the codes as they are stored, clipped like frames are
+            benchFrame src(width, height, getBytesPerSample(format));
+            std::vector<double> in(pixels * 3), expected(pixels * 3);
+            for (int i = 0; i < pixels; ++i)
+            {
+                int index[3] = {i % accuracySteps, i / accuracySteps % accuracySteps, i / width};
+                for (int c = 0; c < 3; ++c)
+                {
+                    uint8_t *row = src.planes[c] + src.stride * index[2];
+                    setSample(row, i % width, index[c] / double(accuracySteps - 1), format);
+                    in[i * 3 + c] = getSample(row, i % width, format);
+                }
+            }
+            cmsDoTransform(reference, in.data(), expected.data(), pixels);
+            for (auto &v : expected)
+                v = std::min(std::max(v, 0.0), 1.0);
+            std::vector<cmsCIELab> expectedLab(pixels), resultLab(pixels);
+            cmsDoTransform(toLab, expected.data(), expectedLab.data(), pixels);
+
+            for (const char *engine : accuracyEngines)
+            {
+                std::string engineName = engine;
+                if (options.engine && engineName != options.engine) continue;
+                if (engineName == "lut" && format.sampleType == stFloat) continue;
+                // Same results on every CPU are only promised by the engines of our own
+                bool promised = engineName != "lcms";
+
+                for (int clutSize : options.clutSizes)
+                {
+                    std::string error;
+                    benchFrame dst(width, height, getBytesPerSample(format));
+                    if (!convertGrid(pair, format, engine, clutSize, cpuLevel, src, dst, error))
+                    {
+                        fprintf(stderr, "iccc_bench: %s %s %s clut_size=%d: %s\n", pair.name, format.name, engine, clutSize, error.c_str());
+                        failed = true;
+                        continue;
+                    }
+
+                    std::vector<double> result(pixels * 3);
+                    for (int i = 0; i < pixels; ++i)
+                        for (int c = 0; c < 3; ++c)
+                            result[i * 3 + c] = getSample(dst.planes[c] + dst.stride * (i / width), i % width, format);
+                    cmsDoTransform(toLab, result.data(), resultLab.data(), pixels);
+                    double maxDeltaE = 0.0, sumDeltaE = 0.0;
+                    int invalid = 0;
+                    for (int i = 0; i < pixels; ++i)
+                    {
+                        double deltaE = cmsCIE2000DeltaE(&expectedLab[i], &resultLab[i], 1.0, 1.0, 1.0);
+                        if (!std::isfinite(deltaE))
+                        {
+                            ++invalid;
+                            continue;
+                        }
+                        maxDeltaE = std::max(maxDeltaE, deltaE);
+                        sumDeltaE += deltaE;
+                    }
+                    if (invalid)
+                    {
+                        fprintf(stderr, "iccc_bench: %s %s %s clut_size=%d: %d pixels aren't comparable.\n", pair.name, format.name, engine, clutSize, invalid);
+                        failed = true;
+                    }
+
+                    // Every lower SIMD level has to give the same bytes as the best one
+                    std::string mismatch;
+                    for (int level = static_cast<int>(simdLevel::none); level < static_cast<int>(cpuLevel) && promised && mismatch.empty(); ++level)
+                    {
+                        benchFrame other(width, height, getBytesPerSample(format));
+                        if (!convertGrid(pair, format, engine, clutSize, static_cast<simdLevel>(level), src, other, error))
+                        {
+                            fprintf(stderr, "iccc_bench: %s %s %s clut_size=%d: %s\n", pair.name, format.name, engine, clutSize, error.c_str());
+                            failed = true;
+                            continue;
+                        }
+                        for (int p = 0; p < 3 && mismatch.empty(); ++p)
+                        {
+                            if (memcmp(dst.planes[p], other.planes[p], dst.stride * height) != 0)
+                                mismatch = simdLevelNames[level];
+                        }
+                    }
+                    if (!mismatch.empty())
+                    {
+                        fprintf(stderr, "iccc_bench: %s %s %s clut_size=%d: Results with %s differ from %s.\n", pair.name, format.name, engine, clutSize, mismatch.c_str(), simdLevelNames[static_cast<int>(cpuLevel)]);
+                        failed = true;
+                    }
+
+                    fprintf(out, "%s    {\"pair\": \"%s\", \"format\": \"%s\", \"engine\": \"%s\", \"clut_size\": %d, "
+                        "\"delta_e_max\": %.4f, \"delta_e_mean\": %.4f, \"simd_identical\": %s}",
+                        separator, pair.name, format.name, engine, clutSize, maxDeltaE, sumDeltaE / pixels,
+                        !promised ? "null" : mismatch.empty() ? "true" : "false");
+                    fflush(out);
+                    separator = ",\n";
+                }
+            }
+        }
+        cmsDeleteTransform(reference);
+        cmsDeleteTransform(toLab);
+    }
+    cmsCloseProfile(lab);
+
+    fprintf(out, "\n  ]\n}\n");
+    return !failed;
+}
+
+int main(int argc, char **argv)
+{
+    benchOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage();
+        return 2;
+    }
+
+    FILE *out = options.output ? fopen(options.output, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "iccc_bench: Unable to write %s.\n", options.output);
+        return 1;
+    }
+
+    benchProfiles profiles;
+    if (!writeProfiles(profiles, options.accuracy))
+    {
+        fprintf(stderr, "iccc_bench: Unable to write profiles to the working directory.\n");
+        return 1;
+    }
+
+    int coreThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    bool passed = options.accuracy ? runAccuracy(options, profiles, out) : runThroughput(options, profiles, coreThreads, out);
+
+    if (out != stdout) fclose(out);
+    return passed ? 0 : 1;
+}
@@ -1,4 +1,5 @@
 #include "common.hpp"
+#include <algorithm>
 #include <cmath>
 
 // This part generates a BT.1886 profile, basically, taken from mpv
@@ -54,7 +55,8 @@ cmsHPROFILE getPlaybackProfile(const cspData &csp, const double gamma, const dou
         for (int i = 0; i < 3; ++i)
         {
             const double gamma = 2.4;
-            double binv = pow(srcBlack[i], 1.0 / gamma);
+            // A zero black point may come back slightly negative from the matrix
+            double binv = pow(std::max(srcBlack[i], 0.0), 1.0 / gamma);
             cmsFloat64Number params[4] = {gamma, 1.0 - binv, binv, 0.0};
             if (!(toneCurve[i] = cmsBuildParametricToneCurve(context, 6, params))) return nullptr;
         }
@@ -0,0 +1,67 @@
+#include "cache.hpp"
+
+// Threads take the slots in the order they first read
+unsigned epochReclaimer::getSlot()
+{
+    static std::atomic<unsigned> next{0};
+    thread_local unsigned slot = next.fetch_add(1, std::memory_order_relaxed) % slotCount;
+    return slot;
+}
+
+bool epochReclaimer::hasReaders(unsigned parity) const
+{
+    int count = 0;
+    for (auto &slot : slots)
+        count += slot.readers[parity].load();
+    return count != 0;
+}
+
+unsigned epochReclaimer::enter()
+{
+    std::atomic<int> *readers = slots[getSlot()].readers;
+    for (;;)
+    {
+        unsigned current = epoch.load(std::memory_order_acquire);
+        // Sequentially consistent, so that collect() sees the count or this sees the new epoch
+        readers[current & 1].fetch_add(1);
+        // Counted in the right parity only if the epoch didn't move in between
+        if (epoch.load() == current) return current;
+        readers[current & 1].fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void epochReclaimer::leave(unsigned e)
+{
+    slots[getSlot()].readers[e & 1].fetch_sub(1, std::memory_order_release);
+}
+
+void epochReclaimer::retire(std::function<void()> deleter)
+{
+    retired.emplace_back(epoch.load(), std::move(deleter));
+}
+
+void epochReclaimer::collect()
+{
+    // Readers of the epoch before the current one share the parity of the next one
+    unsigned current = epoch.load();
+    if (!hasReaders((current + 1) & 1))
+        epoch.store(++current);
+
+    // Nodes retired in epoch e may still be used by readers that entered in e, which are gone once e + 2 is reached
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i)
+    {
+        if (current - retired[i].first >= 2)
+            retired[i].second();
+        else
+            retired[kept++] = std::move(retired[i]);
+    }
+    retired.resize(kept);
+}
+
+void epochReclaimer::clear()
+{
+    for (auto &r : retired)
+        r.second();
+    retired.clear();
+}
@@ -0,0 +1,170 @@
+#ifndef _ICCC_CACHE
+#define _ICCC_CACHE
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Hash map owning its values, with lookups that don't lock.
+// Insertions and removals must be serialized by the caller, and removed nodes may only be freed
+// once no lookup can still be walking through them, see epochReclaimer.
+template <typename Key, typename T, typename Hash>
+class lockFreeMap
+{
+public:
+    struct node
+    {
+        Key key;
+        std::unique_ptr<T> value;
+        std::atomic<node *> next;
+
+        node(const Key &key, T *value, node *next) : key{key}, value{value}, next{next} {}
+    };
+
+    lockFreeMap() = default;
+    lockFreeMap(const lockFreeMap &) = delete;
+    lockFreeMap &operator=(const lockFreeMap &) = delete;
+
+    ~lockFreeMap()
+    {
+        clear();
+    }
+
+    T *find(const Key &key) const
+    {
+        const node *n = buckets[Hash()(key) % bucketCount].load(std::memory_order_acquire);
+        for (; n; n = n->next.load(std::memory_order_acquire))
+        {
+            if (n->key == key) return n->value.get();
+        }
+        return nullptr;
+    }
+
+    // Takes ownership of the value
+    void insert(const Key &key, T *value)
+    {
+        std::atomic<node *> &bucket = buckets[Hash()(key) % bucketCount];
+        bucket.store(new node(key, value, bucket.load(std::memory_order_relaxed)), std::memory_order_release);
+    }
+
+    // Visits every node, the caller must serialize this with updates
+    template <typename Visitor>
+    void forEach(Visitor visit) const
+    {
+        for (auto &bucket : buckets)
+        {
+            for (const node *n = bucket.load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed))
+                visit(n->key, n->value.get());
+        }
+    }
+
+    // Unlinks the nodes whose value matches, lookups in progress may still reach them
+    template <typename Predicate>
+    void unlinkIf(Predicate pred, std::vector<node *> &unlinked)
+    {
+        for (auto &bucket : buckets)
+        {
+            std::atomic<node *> *link = &bucket;
+            node *n = link->load(std::memory_order_relaxed);
+            while (n)
+            {
+                node *next = n->next.load(std::memory_order_relaxed);
+                if (pred(n->key, n->value.get()))
+                {
+                    link->store(next, std::memory_order_release);
+                    unlinked.push_back(n);
+                }
+                else
+                    link = &n->next;
+                n = next;
+            }
+        }
+    }
+
+    // Frees all nodes, no lookup may run concurrently
+    void clear()
+    {
+        for (auto &bucket : buckets)
+        {
+            node *n = bucket.exchange(nullptr);
+            while (n)
+            {
+                node *next = n->next.load(std::memory_order_relaxed);
+                delete n;
+                n = next;
+            }
+        }
+    }
+
+private:
+    static constexpr size_t bucketCount = 64;
+    std::atomic<node *> buckets[bucketCount] = {};
+};
+
+// Epoch based reclamation for lockFreeMap. Readers register in the current epoch for as long as
+// they use what they found, removed nodes are freed after two epochs without such readers.
+// Readers are counted in per-thread slots on their own cache lines, so that they don't contend.
+class epochReclaimer
+{
+public:
+    epochReclaimer() = default;
+    epochReclaimer(const epochReclaimer &) = delete;
+    epochReclaimer &operator=(const epochReclaimer &) = delete;
+
+    ~epochReclaimer()
+    {
+        clear();
+    }
+
+    // Returns the epoch to pass to leave(), which must be called by the same thread
+    unsigned enter();
+    void leave(unsigned epoch);
+
+    // These must be serialized by the caller, like the map updates
+    void retire(std::function<void()> deleter);
+    // Advances the epoch if possible and frees what no reader can see anymore
+    void collect();
+
+    // Frees everything, no reader may be left
+    void clear();
+
+private:
+    static constexpr unsigned slotCount = 64;
+
+    // Readers of each epoch parity, threads beyond the slot count share them
+    struct alignas(64) readerSlot
+    {
+        std::atomic<int> readers[2] = {};
+    };
+
+    static unsigned getSlot();
+    bool hasReaders(unsigned parity) const;
+
+    std::atomic<unsigned> epoch{0};
+    readerSlot slots[slotCount];
+    std::vector<std::pair<unsigned, std::function<void()>>> retired;
+};
+
+// Keeps what a frame found in the caches alive until it's done
+class epochGuard
+{
+public:
+    explicit epochGuard(epochReclaimer *reclaimer) : reclaimer{reclaimer}, epoch{reclaimer ? reclaimer->enter() : 0} {}
+
+    ~epochGuard()
+    {
+        if (reclaimer) reclaimer->leave(epoch);
+    }
+
+    epochGuard(const epochGuard &) = delete;
+    epochGuard &operator=(const epochGuard &) = delete;
+
+private:
+    epochReclaimer *reclaimer;
+    unsigned epoch;
+};
+
+#endif
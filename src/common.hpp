@@ -90,4 +90,16 @@ const cspData csp_2020 = {0.3127, 0.3290, 0.708, 0.292, 0.17, 0.797, 0.131, 0.04
 
 cmsHPROFILE getPlaybackProfile(const cspData &csp, const double gamma, const double contrast, const cmsHPROFILE &displayProfile);
 
+// Converts rows of planar RGB samples without going through lcms
+class planarEngine
+{
+public:
+    virtual ~planarEngine() = default;
+
+    virtual void apply(const void * const src[3], void * const dst[3], int width) const = 0;
+
+    // Bytes held by the tables
+    virtual size_t footprint() const = 0;
+};
+
 #endif
@@ -0,0 +1,198 @@
+#include "depth.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+void widenDepth(const void *src, uint16_t *dst, int width, int bits)
+{
+    const uint16_t *srcp = static_cast<const uint16_t *>(src);
+    int shift = 16 - bits;
+    int back = bits - shift;
+    for (int x = 0; x < width; ++x)
+        dst[x] = static_cast<uint16_t>(srcp[x] << shift | srcp[x] >> back);
+}
+
+constexpr int bayerSize = 16;
+constexpr int blueNoiseSize = 64;
+
+// Thresholds of a 16x16 Bayer matrix in (0, 1)
+static const float *getBayerMatrix()
+{
+    static const std::vector<float> matrix = []()
+    {
+        std::vector<float> m(bayerSize * bayerSize);
+        for (int y = 0; y < bayerSize; ++y)
+        {
+            for (int x = 0; x < bayerSize; ++x)
+            {
+                // Bits of x ^ y and y interleaved from the lowest, most significant first
+                int v = 0;
+                for (int bit = 0; bit < 4; ++bit)
+                    v |= (((x ^ y) >> bit) & 1) << (7 - 2 * bit) | ((y >> bit) & 1) << (6 - 2 * bit);
+                m[y * bayerSize + x] = (v + 0.5f) / (bayerSize * bayerSize);
+            }
+        }
+        return m;
+    }();
+    return matrix.data();
+}
+
+// Thresholds of a 64x64 tile of blue noise in (0, 1), ranked by void-and-cluster once per process
+static const float *getBlueNoise()
+{
+    static const std::vector<float> noise = []()
+    {
+        constexpr int n = blueNoiseSize;
+        constexpr int area = n * n;
+        // Gaussian of the wrapped distance, sigma 1.5
+        std::vector<float> kernel(area);
+        for (int dy = 0; dy < n; ++dy)
+        {
+            for (int dx = 0; dx < n; ++dx)
+            {
+                int wy = std::min(dy, n - dy);
+                int wx = std::min(dx, n - dx);
+                kernel[dy * n + dx] = std::exp(-(wx * wx + wy * wy) / (2.0f * 1.5f * 1.5f));
+            }
+        }
+        std::vector<char> pattern(area, 0);
+        std::vector<float> energy(area, 0.0f);
+        auto toggle = [&](int p, bool set)
+        {
+            pattern[p] = set;
+            int py = p / n, px = p % n;
+            float sign = set ? 1.0f : -1.0f;
+            for (int y = 0; y < n; ++y)
+            {
+                const float *k = &kernel[((y - py + n) % n) * n];
+                float *e = &energy[y * n];
+                for (int x = 0; x < n; ++x)
+                    e[x] += sign * k[(x - px + n) % n];
+            }
+        };
+        // Tightest cluster among the set points, or largest void among the others
+        auto find = [&](bool cluster)
+        {
+            int best = -1;
+            for (int p = 0; p < area; ++p)
+            {
+                if (pattern[p] == cluster && (best < 0 || (cluster ? energy[p] > energy[best] : energy[p] < energy[best])))
+                    best = p;
+            }
+            return best;
+        };
+
+        // A tenth of the points at fixed random places, moved from clusters to voids until they're even
+        uint32_t seed = 1;
+        int ones = area / 10;
+        for (int i = 0; i < ones;)
+        {
+            seed = seed * 1664525 + 1013904223;
+            int p = static_cast<int>((seed >> 8) % area);
+            if (pattern[p]) continue;
+            toggle(p, true);
+            ++i;
+        }
+        for (;;)
+        {
+            int cluster = find(true);
+            toggle(cluster, false);
+            int gap = find(false);
+            toggle(gap, true);
+            if (gap == cluster) break;
+        }
+
+        // Ranks: the initial points from their clusters down, then the rest into the voids
+        std::vector<char> initial = pattern;
+        std::vector<float> initialEnergy = energy;
+        std::vector<int> rank(area);
+        for (int r = ones - 1; r >= 0; --r)
+        {
+            int p = find(true);
+            toggle(p, false);
+            rank[p] = r;
+        }
+        pattern = initial;
+        energy = initialEnergy;
+        for (int r = ones; r < area; ++r)
+        {
+            int p = find(false);
+            toggle(p, true);
+            rank[p] = r;
+        }
+
+        std::vector<float> thresholds(area);
+        for (int p = 0; p < area; ++p)
+            thresholds[p] = (rank[p] + 0.5f) / area;
+        return thresholds;
+    }();
+    return noise.data();
+}
+
+// Rounded to nearest, v * peak / 65535 with the division done as t / 65536 * (1 + 1 / 65536), which is exact here
+template <typename T>
+static void roundRow(const uint16_t *src, T *dst, int width, uint32_t peak)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        uint32_t t = src[x] * peak + 32767;
+        dst[x] = static_cast<T>((t + (t >> 16) + 1) >> 16);
+    }
+}
+
+// Rounded down after adding a threshold of the tile, which is a power of 2 wide. The peak only guards float error.
+template <typename T>
+static void thresholdRow(const uint16_t *src, T *dst, int width, float scale, float peak, const float *tile, int size, int y, int plane)
+{
+    // Each plane takes another part of the tile, so that the channels don't move together
+    const float *row = tile + ((y + plane * 41) & (size - 1)) * size;
+    int offset = plane * 23;
+    for (int x = 0; x < width; ++x)
+        dst[x] = static_cast<T>(std::min(src[x] * scale + row[(x + offset) & (size - 1)], peak));
+}
+
+// Floyd-Steinberg in serpentine order, the rows of the error alternate with y
+template <typename T>
+static void diffuseRow(const uint16_t *src, T *dst, int width, float scale, float peak, int y, float *error)
+{
+    float *current = error + (y & 1) * (width + 2) + 1;
+    float *next = error + ((y + 1) & 1) * (width + 2) + 1;
+    int step = y & 1 ? -1 : 1;
+    int x = y & 1 ? width - 1 : 0;
+    for (int i = 0; i < width; ++i, x += step)
+    {
+        float v = src[x] * scale + current[x];
+        float q = std::min(std::max(std::floor(v + 0.5f), 0.0f), peak);
+        dst[x] = static_cast<T>(q);
+        float e = v - q;
+        current[x + step] += e * (7.0f / 16.0f);
+        next[x - step] += e * (3.0f / 16.0f);
+        next[x] += e * (5.0f / 16.0f);
+        next[x + step] += e * (1.0f / 16.0f);
+    }
+    // Becomes the next row of the row after
+    std::fill(current - 1, current + width + 1, 0.0f);
+}
+
+template <typename T>
+static void reduce(const uint16_t *src, T *dst, int width, int bits, ditherType dither, int y, int plane, float *error)
+{
+    uint32_t peak = (1u << bits) - 1;
+    float scale = peak / 65535.0f;
+    if (dither == ditherType::ordered)
+        thresholdRow(src, dst, width, scale, static_cast<float>(peak), getBayerMatrix(), bayerSize, y, plane);
+    else if (dither == ditherType::blueNoise)
+        thresholdRow(src, dst, width, scale, static_cast<float>(peak), getBlueNoise(), blueNoiseSize, y, plane);
+    else if (dither == ditherType::errorDiffusion)
+        diffuseRow(src, dst, width, scale, static_cast<float>(peak), y, error);
+    else
+        roundRow(src, dst, width, peak);
+}
+
+void reduceDepth(const uint16_t *src, void *dst, int width, int bits, ditherType dither, int y, int plane, float *error)
+{
+    if (bits == 8)
+        reduce(src, static_cast<uint8_t *>(dst), width, bits, dither, y, plane, error);
+    else
+        reduce(src, static_cast<uint16_t *>(dst), width, bits, dither, y, plane, error);
+}
@@ -0,0 +1,25 @@
+#ifndef _ICCC_DEPTH
+#define _ICCC_DEPTH
+
+#include <cstdint>
+
+// Conversions of one row between 8 to 15 bit integer samples and the 16 bit samples transforms work on.
+// Widening replicates the top bits into the low ones, so that the peak maps to 65535 and reducing without
+// dither gives every code back unchanged.
+void widenDepth(const void *src, uint16_t *dst, int width, int bits);
+
+// Dither of reduced output
+enum class ditherType
+{
+    none,
+    ordered,
+    blueNoise,
+    errorDiffusion
+};
+
+// Reduces row y of a plane to bits, 8 bit output in bytes. The patterns are placed by y and the plane.
+// Error diffusion carries its error to the next row in two rows of width + 2 floats, zeroed before the first
+// row, so the rows of a plane have to come one after another.
+void reduceDepth(const uint16_t *src, void *dst, int width, int bits, ditherType dither, int y, int plane, float *error);
+
+#endif
@@ -0,0 +1,191 @@
+#include "diskcache.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined (_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined (_WIN32)
+static std::wstring toWide(const std::string &s)
+{
+    int count = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, nullptr, 0);
+    if (count <= 0) return std::wstring();
+    std::wstring ws(count, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &ws[0], count);
+    ws.resize(count - 1);
+    return ws;
+}
+
+mappedFile *mappedFile::open(const std::string &path)
+{
+    HANDLE file = CreateFileW(toWide(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The mapping keeps the file open
+    CloseHandle(file);
+    if (!mapping) return nullptr;
+    const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        return nullptr;
+    }
+    mappedFile *mf = new mappedFile();
+    mf->view = static_cast<const uint8_t *>(view);
+    mf->length = static_cast<size_t>(size.QuadPart);
+    mf->mapping = mapping;
+    return mf;
+}
+
+mappedFile::~mappedFile()
+{
+    UnmapViewOfFile(view);
+    CloseHandle(mapping);
+}
+
+std::string getDiskCacheDir()
+{
+    const wchar_t *base = _wgetenv(L"LOCALAPPDATA");
+    if (!base || !*base) return std::string();
+    int count = WideCharToMultiByte(CP_UTF8, 0, base, -1, nullptr, 0, nullptr, nullptr);
+    if (count <= 0) return std::string();
+    std::string dir(count, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, base, -1, &dir[0], count, nullptr, nullptr);
+    dir.resize(count - 1);
+    return dir + "\\iccc";
+}
+#else
+mappedFile *mappedFile::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    void *view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after closing
+    close(fd);
+    if (view == MAP_FAILED) return nullptr;
+    mappedFile *mf = new mappedFile();
+    mf->view = static_cast<const uint8_t *>(view);
+    mf->length = static_cast<size_t>(st.st_size);
+    return mf;
+}
+
+mappedFile::~mappedFile()
+{
+    munmap(const_cast<uint8_t *>(view), length);
+}
+
+std::string getDiskCacheDir()
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg == '/') return std::string(xdg) + "/iccc";
+    const char *home = getenv("HOME");
+    if (home && *home) return std::string(home) + "/.cache/iccc";
+    return std::string();
+}
+#endif
+
+uint64_t hashBlob(const uint8_t *data, size_t size)
+{
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto read = [](const uint8_t *p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; };
+
+    uint64_t lanes[4] = {prime1 + prime2, prime2, 0, 0 - prime1};
+    size_t pos = 0;
+    for (; pos + 32 <= size; pos += 32)
+    {
+        for (int i = 0; i < 4; ++i)
+            lanes[i] = rotl(lanes[i] + read(data + pos + i * 8) * prime2, 31) * prime1;
+    }
+    uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + size;
+    for (; pos + 8 <= size; pos += 8)
+        h = rotl(h ^ (rotl(read(data + pos) * prime2, 31) * prime1), 27) * prime1;
+    for (; pos < size; ++pos)
+        h = rotl(h ^ (data[pos] * prime1), 11) * prime2;
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    return h;
+}
+
+std::string joinPath(const std::string &dir, const std::string &name)
+{
+#if defined (_WIN32)
+    return dir + '\\' + name;
+#else
+    return dir + '/' + name;
+#endif
+}
+
+// Creates a directory and its parents, true if it exists afterwards
+static bool createDirectories(const std::string &dir)
+{
+#if defined (_WIN32)
+    std::wstring path = toWide(dir);
+    DWORD attributes = GetFileAttributesW(path.c_str());
+    if (attributes != INVALID_FILE_ATTRIBUTES) return (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    size_t slash = dir.find_last_of("\\/");
+    if (slash != std::string::npos && slash > 0 && !createDirectories(dir.substr(0, slash))) return false;
+    return CreateDirectoryW(path.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    if (stat(dir.c_str(), &st) == 0) return S_ISDIR(st.st_mode);
+    size_t slash = dir.find_last_of('/');
+    if (slash != std::string::npos && slash > 0 && !createDirectories(dir.substr(0, slash))) return false;
+    return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool writeCacheFile(const std::string &dir, const std::string &name, const void *header, size_t headerSize, const void *body, size_t bodySize)
+{
+    if (!createDirectories(dir)) return false;
+
+    // Unique among the processes and the threads writing to the same directory
+    static std::atomic<unsigned> counter{0};
+#if defined (_WIN32)
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+    std::string path = joinPath(dir, name);
+    std::string temp = path + ".tmp" + std::to_string(pid) + "-" + std::to_string(counter++);
+
+#if defined (_WIN32)
+    FILE *file = _wfopen(toWide(temp).c_str(), L"wb");
+#else
+    FILE *file = fopen(temp.c_str(), "wb");
+#endif
+    if (!file) return false;
+    bool written = fwrite(header, 1, headerSize, file) == headerSize && fwrite(body, 1, bodySize, file) == bodySize;
+    written = fclose(file) == 0 && written;
+
+#if defined (_WIN32)
+    // Fails if another process has the old file mapped, which then stays
+    if (written)
+        written = MoveFileExW(toWide(temp).c_str(), toWide(path).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    if (!written)
+        DeleteFileW(toWide(temp).c_str());
+#else
+    if (written)
+        written = rename(temp.c_str(), path.c_str()) == 0;
+    if (!written)
+        unlink(temp.c_str());
+#endif
+    return written;
+}
@@ -0,0 +1,53 @@
+#ifndef _ICCC_DISKCACHE
+#define _ICCC_DISKCACHE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A whole file mapped read-only. Processes mapping the same file share its pages.
+class mappedFile
+{
+public:
+    // Returns null if the file can't be opened or is empty
+    static mappedFile *open(const std::string &path);
+    ~mappedFile();
+
+    mappedFile(const mappedFile &) = delete;
+    mappedFile &operator=(const mappedFile &) = delete;
+
+    const uint8_t *data() const
+    {
+        return view;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    mappedFile() = default;
+
+    const uint8_t *view = nullptr;
+    size_t length = 0;
+#if defined (_WIN32)
+    void *mapping = nullptr;
+#endif
+};
+
+// Default directory of the disk cache: $XDG_CACHE_HOME/iccc, ~/.cache/iccc, or %LOCALAPPDATA%\iccc on Windows.
+// Empty if none of them is set.
+std::string getDiskCacheDir();
+
+// Fast non-cryptographic hash, 32 bytes per round like xxHash64. Used for raw profiles and the tables in the disk cache.
+uint64_t hashBlob(const uint8_t *data, size_t size);
+
+// Path of a file in the given directory
+std::string joinPath(const std::string &dir, const std::string &name);
+
+// Writes header and body to a file under the given directory, which is created if needed.
+// The data goes to a temporary file that is then renamed, so readers never see a partial file.
+bool writeCacheFile(const std::string &dir, const std::string &name, const void *header, size_t headerSize, const void *body, size_t bodySize);
+
+#endif
@@ -0,0 +1,61 @@
+#include "gray.hpp"
+#include <algorithm>
+
+template <typename T>
+static void lookup(const std::vector<T> &table, int channels, const void *src, void * const dst[3], int width)
+{
+    const T *srcp = static_cast<const T *>(src);
+    size_t codes = table.size() / channels;
+    for (int c = 0; c < channels; ++c)
+    {
+        const T *t = table.data() + codes * c;
+        T *dstp = static_cast<T *>(dst[c]);
+        for (int x = 0; x < width; ++x)
+            dstp[x] = t[srcp[x]];
+    }
+}
+
+template <typename T>
+static void sample(cmsHTRANSFORM transform, int channels, std::vector<T> &table)
+{
+    size_t codes = size_t(1) << (8 * sizeof(T));
+    float peak = static_cast<float>(codes - 1);
+    // 8 bit codes are sampled at their exact 16 bit values
+    std::vector<cmsUInt16Number> input(codes);
+    for (size_t i = 0; i < codes; ++i)
+        input[i] = static_cast<cmsUInt16Number>(i * (65535 / (codes - 1)));
+    std::vector<cmsFloat32Number> output(codes * channels);
+    cmsDoTransform(transform, input.data(), output.data(), static_cast<cmsUInt32Number>(codes));
+
+    table.resize(codes * channels);
+    for (size_t i = 0; i < codes; ++i)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            float v = std::min(std::max(output[i * channels + c] * peak, 0.0f), peak);
+            table[codes * c + i] = static_cast<T>(v + 0.5f);
+        }
+    }
+}
+
+grayEngine *grayEngine::create(cmsHTRANSFORM transform, int channels, int bytesPerSample)
+{
+    if ((channels != 1 && channels != 3) || (bytesPerSample != 1 && bytesPerSample != 2))
+        return nullptr;
+
+    grayEngine *engine = new grayEngine();
+    engine->channels = channels;
+    if (bytesPerSample == 1)
+        sample(transform, channels, engine->table8);
+    else
+        sample(transform, channels, engine->table16);
+    return engine;
+}
+
+void grayEngine::apply(const void * const src[3], void * const dst[3], int width) const
+{
+    if (!table8.empty())
+        lookup(table8, channels, src[0], dst, width);
+    else
+        lookup(table16, channels, src[0], dst, width);
+}
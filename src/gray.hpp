@@ -0,0 +1,35 @@
+#ifndef _ICCC_GRAY
+#define _ICCC_GRAY
+
+#include "common.hpp"
+#include <vector>
+
+// Gray input has few enough codes that the transform is sampled at every one of them,
+// so a row is converted with one table lookup per output plane.
+class grayEngine : public planarEngine
+{
+public:
+    // Samples a transform from TYPE_GRAY_16 to TYPE_GRAY_FLT (1 channel) or TYPE_RGB_FLT (3 channels), null on failure
+    static grayEngine *create(cmsHTRANSFORM transform, int channels, int bytesPerSample);
+
+    grayEngine(const grayEngine &) = delete;
+    grayEngine &operator=(const grayEngine &) = delete;
+
+    // Converts one row of the first source plane into each output plane
+    void apply(const void * const src[3], void * const dst[3], int width) const override;
+
+    size_t footprint() const override
+    {
+        return table8.size() + table16.size() * sizeof(uint16_t);
+    }
+
+private:
+    grayEngine() = default;
+
+    // Output codes of every input code, plane after plane
+    std::vector<uint8_t> table8;
+    std::vector<uint16_t> table16;
+    int channels = 1;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "half.hpp"
+#include "simd.hpp"
+#include <cstring>
+
+float halfToFloat(uint16_t h)
+{
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F) // Infinity, NaNs are made quiet like F16C does
+        bits = sign | 0x7F800000 | (mantissa ? 0x400000 : 0) | (mantissa << 13);
+    else if (exponent > 0)
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else
+    {
+        // Denormals are multiples of 2^-24, which is exact in float
+        float v = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        memcpy(&bits, &v, sizeof(bits));
+        bits |= sign;
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+uint16_t floatToHalf(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude > 0x7F800000) // NaN keeps the top of its payload, made quiet
+        return sign | 0x7E00 | ((magnitude >> 13) & 0x3FF);
+    if (magnitude >= 0x477FF000) // 65520 and above round to infinity
+        return sign | 0x7C00;
+    if (magnitude < 0x38800000)
+    {
+        // Denormal results: adding 0.5 leaves 2^-24 steps in the mantissa, rounded by the FPU
+        float v;
+        memcpy(&v, &magnitude, sizeof(v));
+        v += 0.5f;
+        memcpy(&magnitude, &v, sizeof(magnitude));
+        return sign | static_cast<uint16_t>(magnitude - 0x3F000000);
+    }
+    // Rebias the exponent and round the 13 dropped bits to nearest even
+    magnitude += 0xC8000FFF + ((magnitude >> 13) & 1);
+    return sign | static_cast<uint16_t>(magnitude >> 13);
+}
+
+void halfToFloat_c(const void *src, float *dst, int width)
+{
+    const uint16_t *srcp = static_cast<const uint16_t *>(src);
+    for (int x = 0; x < width; ++x)
+        dst[x] = halfToFloat(srcp[x]);
+}
+
+void floatToHalf_c(const float *src, void *dst, int width)
+{
+    uint16_t *dstp = static_cast<uint16_t *>(dst);
+    for (int x = 0; x < width; ++x)
+        dstp[x] = floatToHalf(src[x]);
+}
+
+// F16C comes with every CPU that has AVX2, so it follows that level
+static bool useF16C()
+{
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    return getSimdLevel() >= simdLevel::avx2 && p2p::simd::query_x86_capabilities().f16c;
+#else
+    return false;
+#endif
+}
+
+halfToFloatKernel getHalfToFloat()
+{
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    if (useF16C())
+        return halfToFloat_f16c;
+#endif
+    return halfToFloat_c;
+}
+
+floatToHalfKernel getFloatToHalf()
+{
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    if (useF16C())
+        return floatToHalf_f16c;
+#endif
+    return floatToHalf_c;
+}
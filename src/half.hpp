@@ -0,0 +1,23 @@
+#ifndef _ICCC_HALF
+#define _ICCC_HALF
+
+#include <cstdint>
+
+// Conversions of one row between half floats (RGBH) and the single floats transforms work on.
+// Rounding is to nearest even, so that every kernel gives the same bits.
+typedef void (*halfToFloatKernel)(const void *src, float *dst, int width);
+typedef void (*floatToHalfKernel)(const float *src, void *dst, int width);
+
+float halfToFloat(uint16_t h);
+uint16_t floatToHalf(float f);
+
+void halfToFloat_c(const void *src, float *dst, int width);
+void floatToHalf_c(const float *src, void *dst, int width);
+void halfToFloat_f16c(const void *src, float *dst, int width);
+void floatToHalf_f16c(const float *src, void *dst, int width);
+
+// Fastest kernels the CPU supports within the SIMD limit
+halfToFloatKernel getHalfToFloat();
+floatToHalfKernel getFloatToHalf();
+
+#endif
@@ -0,0 +1,28 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <immintrin.h>
+#include "half.hpp"
+
+// Eight samples per iteration, the rest are left to the scalar conversion
+
+void halfToFloat_f16c(const void *src, float *dst, int width)
+{
+    const uint16_t *srcp = static_cast<const uint16_t *>(src);
+    int body = width - width % 8;
+    for (int x = 0; x < body; x += 8)
+        _mm256_storeu_ps(dst + x, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(srcp + x))));
+    halfToFloat_c(srcp + body, dst + body, width - body);
+}
+
+void floatToHalf_f16c(const float *src, void *dst, int width)
+{
+    uint16_t *dstp = static_cast<uint16_t *>(dst);
+    int body = width - width % 8;
+    for (int x = 0; x < body; x += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dstp + x), _mm256_cvtps_ph(_mm256_loadu_ps(src + x), _MM_FROUND_TO_NEAREST_INT));
+    floatToHalf_c(src + body, dstp + body, width - body);
+}
+
+#endif
+#endif
@@ -1,9 +1,29 @@
+#include "cache.hpp"
 #include "common.hpp"
+#include "depth.hpp"
+#include "diskcache.hpp"
+#include "gray.hpp"
+#include "half.hpp"
+#include "iccc.hpp"
 #include "libp2p/p2p_api.h"
+#include "libp2p/simd/cpuinfo_x86.h"
+#include "lut.hpp"
+#include "shaper.hpp"
+#include "stats.hpp"
 #include "vapoursynth/VSConstants4.h"
-#include <unordered_map>
+#include "workers.hpp"
+#include "yuv.hpp"
+#include <atomic>
 #include <mutex>
 #include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <string>
+#include <unordered_map>
 
 constexpr double REC709_ALPHA = 1.09929682680944;
 constexpr double REC709_BETA = 0.018053968510807;
@@ -43,70 +63,1001 @@ struct inputICCHashFunction
 {
     size_t operator()(const inputICCData &ind) const
     {
-        return ind.intent + ind.ID32[0] + ind.ID32[1] + ind.ID32[2] + ind.ID32[3];
+        size_t hash = ind.intent;
+        for (int j = 0; j < 4; ++j)
+            hash ^= ind.ID32[j] + 0x9E3779B9 + (hash << 6) + (hash >> 2);
+        return hash;
     }
 };
 
+// Reusable aligned interleave buffers and dither error rows, each frame thread holds one at a time
+struct scratchBuffer
+{
+    uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+struct scratchPool
+{
+    std::mutex mutex;
+    std::vector<scratchBuffer> buffers;
+
+    // Returns a buffer of at least the given size, data is null when OOM. New allocations are added to the counter.
+    scratchBuffer acquire(size_t size, std::atomic<uint64_t> &allocated)
+    {
+        scratchBuffer buffer;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!buffers.empty())
+            {
+                buffer = buffers.back();
+                buffers.pop_back();
+            }
+        }
+        // Grow on demand, e.g. for variable resolution clips
+        if (buffer.size < size)
+        {
+            if (buffer.data) vsh::vsh_aligned_free(buffer.data);
+            buffer.data = reinterpret_cast<uint8_t *>(vsh::vsh_aligned_malloc(size, 32));
+            buffer.size = buffer.data ? size : 0;
+            allocated.fetch_add(buffer.size, std::memory_order_relaxed);
+        }
+        return buffer;
+    }
+
+    void release(const scratchBuffer &buffer)
+    {
+        if (!buffer.data) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(buffer);
+    }
+
+    void clear()
+    {
+        for (auto &buffer : buffers)
+            vsh::vsh_aligned_free(buffer.data);
+        buffers.clear();
+    }
+};
+
+// Evaluation of the color transform
+enum class engineType
+{
+    automatic,
+    lcms,
+    lut
+};
+
+// Interleave layout of lcms transforms for 8 and 16 bit input, picked by timing unless it's forced
+enum class layoutType
+{
+    automatic,
+    packed,
+    planar,
+    padded
+};
+
+// A built transform, either run by lcms or by one of the planar engines. Filter instances with the same
+// profiles and settings share it.
+struct sharedTransform
+{
+    cmsHTRANSFORM transform = nullptr;
+    std::unique_ptr<planarEngine> engine;
+    // Approximate memory use
+    size_t footprint = 0;
+    // Maps every value to itself, so frames in the same format are passed through
+    bool identity = false;
+
+    ~sharedTransform()
+    {
+        if (transform) cmsDeleteTransform(transform);
+    }
+};
+
+// A transform in the cache of one filter instance
+struct transformData
+{
+    std::shared_ptr<const sharedTransform> shared;
+    // Memory accounted to this cache, and the cache clock when it was last used
+    size_t footprint = 0;
+    std::atomic<uint64_t> lastUsed{0};
+};
+
+// Raw bytes of an embedded profile, compared before parsing it
+struct profileBlobKey
+{
+    static constexpr size_t headerSize = 128;
+
+    uint64_t hash;
+    size_t size;
+    uint8_t header[headerSize] = {};
+
+    profileBlobKey(const char *data, size_t size) : hash{hashBlob(reinterpret_cast<const uint8_t *>(data), size)}, size{size}
+    {
+        memcpy(header, data, std::min(size, headerSize));
+    }
+
+    bool operator==(const profileBlobKey &key) const
+    {
+        return hash == key.hash && size == key.size && memcmp(header, key.header, headerSize) == 0;
+    }
+};
+
+struct profileBlobHashFunction
+{
+    size_t operator()(const profileBlobKey &key) const
+    {
+        return static_cast<size_t>(key.hash);
+    }
+};
+
+// Everything a transform depends on, to share it between filter instances
+struct transformKey
+{
+    cmsUInt32Number input[4];
+    cmsUInt32Number output[4];
+    cmsUInt32Number proofing[4];
+    cmsUInt32Number intent;
+    cmsUInt32Number proofingIntent;
+    cmsUInt32Number flags;
+    cmsUInt32Number inputType;
+    cmsUInt32Number outputType;
+    cmsUInt32Number engine;
+    cmsUInt32Number clutSize;
+    cmsUInt32Number bytesPerSample;
+    // Gamut warning color, a global of lcms taken when the transform is created
+    cmsUInt32Number alarm[3];
+
+    bool operator==(const transformKey &key) const
+    {
+        return memcmp(this, &key, sizeof(transformKey)) == 0;
+    }
+};
+
+struct transformKeyHashFunction
+{
+    size_t operator()(const transformKey &key) const
+    {
+        return static_cast<size_t>(hashBlob(reinterpret_cast<const uint8_t *>(&key), sizeof(transformKey)));
+    }
+};
+
+// Interleave layout of lcms transforms
+struct layoutChoice
+{
+    cmsUInt32Number type;
+    p2p_packing p2pType;
+};
+
+// Transforms of all filter instances in the process, each one alive as long as an instance holds it
+struct transformRegistry
+{
+    std::mutex mutex;
+    std::unordered_map<transformKey, std::weak_ptr<const sharedTransform>, transformKeyHashFunction> transforms;
+    // Layouts chosen by timing, by the key with the packed types, so that every instance picks the same
+    std::unordered_map<transformKey, layoutChoice, transformKeyHashFunction> layouts;
+};
+
+static transformRegistry &getRegistry()
+{
+    static transformRegistry registry;
+    return registry;
+}
+
+// MD5 profile ID as lcms computes it but without the creation date, so that presets made at different times match.
+// The given profile is left untouched, the ID is zero on failure.
+static void getProfileID(cmsHPROFILE profile, cmsUInt32Number id[4])
+{
+    memset(id, 0, sizeof(cmsUInt32Number) * 4);
+    cmsUInt32Number size = 0;
+    if (!profile || !cmsSaveProfileToMem(profile, nullptr, &size) || size < 128) return;
+    std::vector<char> data(size);
+    if (!cmsSaveProfileToMem(profile, data.data(), &size)) return;
+    // dateTimeNumber at offset 24 of the header
+    memset(&data[24], 0, 12);
+    cmsHPROFILE copy = cmsOpenProfileFromMem(data.data(), size);
+    if (!copy) return;
+    cmsMD5computeID(copy);
+    cmsGetHeaderProfileID(copy, reinterpret_cast<cmsUInt8Number *>(id));
+    cmsCloseProfile(copy);
+}
+
+// What an embedded profile resolved to, either a transform or the error it causes
+struct profileEntry
+{
+    transformData *transform = nullptr; // Owned by the transform map
+    std::string error;
+    // Prop buffers are shared between frames, so the last one seen usually comes again
+    std::atomic<const char *> lastData{nullptr};
+    profileBlobKey key;
+    // Failed profiles are dropped in order of appearance
+    uint64_t added = 0;
+
+    explicit profileEntry(const profileBlobKey &key) : key{key} {}
+};
+
+// An embedded profile waiting to be resolved, by the background queue or by the first frame that needs it
+struct profileBuild
+{
+    std::vector<char> data;
+    profileBlobKey key;
+    std::atomic<bool> started{false};
+    std::promise<profileEntry *> promise;
+    std::shared_future<profileEntry *> result;
+
+    profileBuild(const char *data, size_t size, const profileBlobKey &key) : data(data, data + size), key{key}, result{promise.get_future().share()} {}
+};
+
 struct icccData
 {
-    // Video
-    VSNode *node = nullptr;
+    // Output video, the format of the input frames, and the RGB (or gray) format of the transforms
     VSVideoInfo vi;
-    std::unordered_map<inputICCData, cmsHTRANSFORM, inputICCHashFunction> transformMap;
-    std::mutex mutex;
+    VSVideoFormat inputFormat;
+    VSVideoFormat rgbFormat;
+    // Colorspace of the input profiles, gray for gray clips
+    cmsColorSpaceSignature inputSpace = cmsSigRgbData;
+    lockFreeMap<inputICCData, transformData, inputICCHashFunction> transforms;
+    // Embedded profiles by raw bytes, including the ones that failed
+    lockFreeMap<profileBlobKey, profileEntry, profileBlobHashFunction> profiles;
+    std::atomic<profileEntry *> lastProfile{nullptr};
+    std::mutex mutex; // Serializes transform creation and cache updates
+    // Cache budget, the default transform is never evicted
+    size_t cacheBudget = 0;
+    size_t cacheBytes = 0;
+    size_t failedProfiles = 0;
+    std::atomic<uint64_t> cacheClock{0};
+    epochReclaimer reclaimer;
+    // Profiles being resolved outside the mutex, by raw bytes like the profile map
+    std::unordered_map<profileBlobKey, std::shared_ptr<profileBuild>, profileBlobHashFunction> pending;
+    // Number of following frames whose profiles are resolved ahead
+    int prefetch = 0;
     // Defaults
     VSColorPrimaries primaries = VSC_PRIMARIES_UNSPECIFIED;
     VSTransferCharacteristics transfer = VSC_TRANSFER_UNSPECIFIED;
+    // Matrix of YUV frames without _Matrix
+    VSMatrixCoefficients matrix = VSC_MATRIX_BT709;
+    // YUV output is encoded from the transformed rows with the matrix of the output primaries
+    yuvEncoder encoder;
+    VSMatrixCoefficients outputMatrix = VSC_MATRIX_UNSPECIFIED;
     cmsHPROFILE outputProfile = nullptr;
+    cmsUInt32Number outputID[4] = {};
     std::vector<char> outputProfileData;
-    cmsHTRANSFORM defaultTransform = nullptr; // This one is a copy from the map, don't free it directly
+    transformData *defaultTransform = nullptr; // This one is owned by the map, don't free it directly
     cmsUInt32Number intent;
     cmsUInt32Number transformFlag;
-    // Format: RGB24, RGB48, RGBS (slow)
+    engineType engine = engineType::automatic;
+    layoutType layout = layoutType::automatic;
+    int clutSize = 49;
+    // Where sampled LUTs are kept between runs, empty if they aren't
+    std::string diskCacheDir;
+    // Format: RGB24, RGB48 (also 9 to 15 bits), RGBS (slow), RGBH (slow). Planar types are either read in place or copied plane by plane.
     cmsUInt32Number inputDataType;
     cmsUInt32Number outputDataType;
     p2p_packing inputP2PType = p2p_packing_max;
     p2p_packing outputP2PType = p2p_packing_max;
+    // Half floats are widened into the buffer and transformed as RGBS, null otherwise
+    halfToFloatKernel halfToFloat = nullptr;
+    floatToHalfKernel floatToHalf = nullptr;
+    // 9 to 15 bit RGB is scaled to 16 bits in the buffer, 0 otherwise
+    int scaledBits = 0;
+    // Transformed 16 bit rows are reduced to fewer bits on output, with the dither, 0 otherwise
+    int reducedBits = 0;
+    ditherType dither = ditherType::none;
+    // Frames of identity transforms are passed through, when the output has the format of the input
+    bool passthrough = false;
     // Flag for using props
     bool preferProps;
     // Proofing profile and intent
     cmsHPROFILE proofingProfile = nullptr;
+    cmsUInt32Number proofingID[4] = {};
     cmsUInt32Number proofingIntent;
+    // Interleave buffers
+    scratchPool pool;
+    // Optional workers for splitting a frame into row bands
+    std::unique_ptr<workerPool> workers;
+    int coreThreads = 1;
+    std::atomic<int> activeFrames{0};
+    // Counters, also listed by iccc.Stats() while the filter lives
+    std::shared_ptr<icccStats> stats = std::make_shared<icccStats>();
+    // Builds transforms for prefetched and warmup profiles, declared last so it stops before the rest is freed
+    std::unique_ptr<backgroundQueue> builder;
     void clear()
     {
+        builder.reset();
+        pending.clear();
         if (outputProfile) cmsCloseProfile(outputProfile);
         outputProfileData.clear();
-        for (auto pair : transformMap)
-        {
-            if (pair.second) cmsDeleteTransform(pair.second);
-        }
+        lastProfile = nullptr;
+        profiles.clear();
+        transforms.clear();
+        reclaimer.clear();
         if (proofingProfile) cmsCloseProfile(proofingProfile);
+        pool.clear();
     }
 };
 
-static cmsHTRANSFORM getTransform(const inputICCData &ind, icccData *d)
+// lcms transform with the proofing profile of the filter if there is one
+static cmsHTRANSFORM createLcmsTransform(cmsHPROFILE input, cmsUInt32Number inputType, cmsHPROFILE output, cmsUInt32Number outputType, cmsUInt32Number intent, cmsUInt32Number flags, const icccData *d)
 {
+    if (d->proofingProfile)
+        return cmsCreateProofingTransform(input, inputType, output, outputType, d->proofingProfile, intent, d->proofingIntent, flags);
+    else
+        return cmsCreateTransform(input, inputType, output, outputType, intent, flags);
+}
+
+// Builds the transform with the selected engine, returns nullptr on failure.
+// Sampled LUTs are loaded from and saved to the disk cache if there is a key for them.
+static sharedTransform *buildTransform(cmsHPROFILE input, cmsHPROFILE output, cmsUInt32Number intent, const transformKey *key, const icccData *d)
+{
+    auto create = [&](cmsUInt32Number inputType, cmsUInt32Number outputType, cmsUInt32Number flags)
+    {
+        return createLcmsTransform(input, inputType, output, outputType, intent, flags, d);
+    };
+
+    std::unique_ptr<sharedTransform> st(new sharedTransform());
+    // Gray codes are all sampled into 1D tables, from the exact pipeline like the LUT engine
+    if (d->inputSpace == cmsSigGrayData)
+    {
+        if (d->engine != engineType::lcms && !T_FLOAT(d->inputDataType))
+        {
+            int channels = T_CHANNELS(d->outputDataType);
+            cmsUInt32Number flags = (d->transformFlag & ~cmsFLAGS_GRIDPOINTS(0xFF)) | cmsFLAGS_NOOPTIMIZE;
+            cmsHTRANSFORM sampler = create(TYPE_GRAY_16, channels == 1 ? TYPE_GRAY_FLT : TYPE_RGB_FLT, flags);
+            if (!sampler) return nullptr;
+            st->engine.reset(grayEngine::create(sampler, channels, d->rgbFormat.bytesPerSample));
+            cmsDeleteTransform(sampler);
+            if (!st->engine) return nullptr;
+        }
+    }
+    else if (d->engine == engineType::lut)
+    {
+        std::string fileName;
+        if (key && !d->diskCacheDir.empty())
+        {
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hashBlob(reinterpret_cast<const uint8_t *>(key), sizeof(transformKey))));
+            fileName = std::string(hex) + ".lut";
+            st->engine.reset(lutEngine::load(joinPath(d->diskCacheDir, fileName), key, sizeof(transformKey), d->clutSize, d->rgbFormat.bytesPerSample));
+        }
+        if (!st->engine)
+        {
+            // Sample the exact pipeline in float rather than the precalculated one of lcms
+            cmsUInt32Number flags = (d->transformFlag & ~cmsFLAGS_GRIDPOINTS(0xFF)) | cmsFLAGS_NOOPTIMIZE;
+            cmsHTRANSFORM sampler = create(TYPE_RGB_16, TYPE_RGB_FLT, flags);
+            if (!sampler) return nullptr;
+            lutEngine *engine = lutEngine::create(sampler, d->clutSize, d->rgbFormat.bytesPerSample);
+            cmsDeleteTransform(sampler);
+            if (!engine) return nullptr;
+            st->engine.reset(engine);
+            // A failed write only costs sampling again next time
+            if (!fileName.empty())
+                engine->save(d->diskCacheDir, fileName, key, sizeof(transformKey));
+        }
+    }
+    // Matrix-shaper pairs skip lcms when the result matches it
+    else if (d->engine == engineType::automatic && !d->proofingProfile && !T_FLOAT(d->inputDataType))
+        st->engine.reset(shaperEngine::create(input, output, intent, d->transformFlag, d->rgbFormat.bytesPerSample));
+
+    if (st->engine)
+        st->footprint = st->engine->footprint();
+    else
+    {
+        st->transform = create(d->inputDataType, d->outputDataType, d->transformFlag);
+        if (!st->transform) return nullptr;
+        // lcms keeps a CLUT of the grid size, in 16 bit or float, plus some small tables
+        size_t grid = static_cast<size_t>(d->clutSize);
+        st->footprint = grid * grid * grid * 3 * (T_FLOAT(d->outputDataType) ? sizeof(cmsFloat32Number) : sizeof(cmsUInt16Number)) + 65536;
+    }
+    return st.release();
+}
+
+// True if the transform maps every value to itself within a quarter of a 16 bit step. Equal profiles are with the
+// relative intent, others are sampled from the exact pipeline, one slice of the grid at a time to stop early.
+static bool isIdentity(cmsHPROFILE input, const cmsUInt32Number inputID[4], cmsHPROFILE output, const cmsUInt32Number outputID[4], cmsUInt32Number intent, const icccData *d)
+{
+    static const cmsUInt32Number noID[4] = {};
+    if (d->proofingProfile || cmsGetColorSpace(input) != cmsGetColorSpace(output))
+        return false;
+    if (intent == INTENT_RELATIVE_COLORIMETRIC && memcmp(inputID, noID, sizeof(noID)) != 0 && memcmp(inputID, outputID, sizeof(noID)) == 0)
+        return true;
+
+    bool gray = d->inputSpace == cmsSigGrayData;
+    cmsUInt32Number type = gray ? TYPE_GRAY_FLT : TYPE_RGB_FLT;
+    cmsUInt32Number flags = (d->transformFlag & ~cmsFLAGS_GRIDPOINTS(0xFF)) | cmsFLAGS_NOOPTIMIZE;
+    cmsHTRANSFORM sampler = cmsCreateTransform(input, type, output, type, intent, flags);
+    if (!sampler) return false;
+
+    // Not a multiple of common CLUT grids, so that their nodes alone don't decide it
+    constexpr int points = 23;
+    constexpr float tolerance = 0.25f / 65535.0f;
+    // Gray takes as many points as one slice, along its only axis
+    int channels = gray ? 1 : 3;
+    int slices = gray ? 1 : points;
+    int count = points * points;
+    std::vector<float> in(count * channels), out(count * channels);
+    bool identity = true;
+    for (int r = 0; r < slices && identity; ++r)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (gray)
+                in[i] = i / (count - 1.0f);
+            else
+            {
+                in[i * 3] = r / (points - 1.0f);
+                in[i * 3 + 1] = i / points / (points - 1.0f);
+                in[i * 3 + 2] = i % points / (points - 1.0f);
+            }
+        }
+        cmsDoTransform(sampler, in.data(), out.data(), count);
+        for (int i = 0; i < count * channels && identity; ++i)
+            identity = std::abs(out[i] - in[i]) <= tolerance;
+    }
+    cmsDeleteTransform(sampler);
+    return identity;
+}
+
+// Key of the transform between two profiles with the given IDs, with the current types of the filter.
+// Returns false if a profile has no ID, then the key doesn't tell the transform apart.
+static bool getTransformKey(const cmsUInt32Number inputID[4], const cmsUInt32Number outputID[4], cmsUInt32Number intent, const icccData *d, transformKey &key)
+{
+    static const cmsUInt32Number noID[4] = {};
+    bool shareable = memcmp(inputID, noID, sizeof(noID)) != 0 && memcmp(outputID, noID, sizeof(noID)) != 0 &&
+        (!d->proofingProfile || memcmp(d->proofingID, noID, sizeof(noID)) != 0);
+
+    memset(&key, 0, sizeof(key));
+    memcpy(key.input, inputID, sizeof(key.input));
+    memcpy(key.output, outputID, sizeof(key.output));
+    memcpy(key.proofing, d->proofingID, sizeof(key.proofing));
+    key.intent = intent;
+    key.proofingIntent = d->proofingProfile ? d->proofingIntent : 0;
+    key.flags = d->transformFlag;
+    key.inputType = d->inputDataType;
+    key.outputType = d->outputDataType;
+    key.engine = static_cast<cmsUInt32Number>(d->engine);
+    key.clutSize = static_cast<cmsUInt32Number>(d->clutSize);
+    key.bytesPerSample = static_cast<cmsUInt32Number>(d->rgbFormat.bytesPerSample);
+    if (d->transformFlag & cmsFLAGS_GAMUTCHECK)
+    {
+        cmsUInt16Number alarm[cmsMAXCHANNELS];
+        cmsGetAlarmCodes(alarm);
+        for (int i = 0; i < 3; ++i)
+            key.alarm[i] = alarm[i];
+    }
+    return shareable;
+}
+
+// Finds the transform between two profiles with the given IDs in the process-wide registry, or builds and registers it.
+// Profiles without an ID aren't shared. Returns nullptr on failure.
+static transformData *createTransform(cmsHPROFILE input, const cmsUInt32Number inputID[4], cmsHPROFILE output, const cmsUInt32Number outputID[4], cmsUInt32Number intent, const icccData *d)
+{
+    transformKey key;
+    bool shareable = getTransformKey(inputID, outputID, intent, d, key);
+
+    transformRegistry &registry = getRegistry();
+    std::shared_ptr<const sharedTransform> shared;
+    if (shareable)
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.transforms.find(key);
+        if (it != registry.transforms.end())
+            shared = it->second.lock();
+    }
+
+    // Built without the lock, if another instance was faster its transform is used instead
+    if (!shared)
+    {
+        auto start = std::chrono::steady_clock::now();
+        sharedTransform *built = buildTransform(input, output, intent, shareable ? &key : nullptr, d);
+        // Checked for every instance, as the transform may be shared with one that can pass frames through
+        if (built)
+            built->identity = isIdentity(input, inputID, output, outputID, intent, d);
+        shared.reset(built);
+        d->stats->add(d->stats->buildNs, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        if (!shared) return nullptr;
+        d->stats->add(d->stats->bytesAllocated, shared->footprint);
+        if (shareable)
+        {
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (auto it = registry.transforms.begin(); it != registry.transforms.end();)
+            {
+                if (it->second.expired()) it = registry.transforms.erase(it);
+                else ++it;
+            }
+            auto inserted = registry.transforms.emplace(key, shared);
+            if (!inserted.second)
+                shared = inserted.first->second.lock();
+        }
+    }
+
+    transformData *td = new transformData();
+    td->footprint = shared->footprint;
+    td->shared = std::move(shared);
+    return td;
+}
+
+// Failed profiles are only kept to skip parsing them again, a few are enough
+constexpr size_t maxFailedProfiles = 64;
+
+// Evicts the least recently used transforms until the cache fits its budget, along with the profiles that use them.
+// The default transform and the given one are kept. The caller must hold the mutex.
+static void trimCache(icccData *d, const transformData *keep)
+{
+    std::vector<lockFreeMap<inputICCData, transformData, inputICCHashFunction>::node *> transformNodes;
+    std::vector<lockFreeMap<profileBlobKey, profileEntry, profileBlobHashFunction>::node *> profileNodes;
+
+    while (d->cacheBytes > d->cacheBudget)
+    {
+        const transformData *victim = nullptr;
+        d->transforms.forEach([&](const inputICCData &, const transformData *t)
+        {
+            if (t != d->defaultTransform && t != keep && (!victim || t->lastUsed.load(std::memory_order_relaxed) < victim->lastUsed.load(std::memory_order_relaxed)))
+                victim = t;
+        });
+        if (!victim) break;
+        d->transforms.unlinkIf([&](const inputICCData &, const transformData *t) { return t == victim; }, transformNodes);
+        d->profiles.unlinkIf([&](const profileBlobKey &, const profileEntry *entry) { return entry->transform == victim; }, profileNodes);
+        d->cacheBytes -= victim->footprint;
+    }
+
+    while (d->failedProfiles > maxFailedProfiles)
+    {
+        const profileEntry *oldest = nullptr;
+        d->profiles.forEach([&](const profileBlobKey &, const profileEntry *entry)
+        {
+            if (!entry->transform && (!oldest || entry->added < oldest->added))
+                oldest = entry;
+        });
+        d->profiles.unlinkIf([&](const profileBlobKey &, const profileEntry *entry) { return entry == oldest; }, profileNodes);
+        d->cacheBytes -= sizeof(profileEntry) + oldest->error.size();
+        --d->failedProfiles;
+    }
+
+    // Frames may still hold what was unlinked, it's freed once they are done
+    for (auto n : profileNodes)
+    {
+        profileEntry *entry = n->value.get();
+        d->lastProfile.compare_exchange_strong(entry, nullptr);
+        d->reclaimer.retire([n]() { delete n; });
+    }
+    for (auto n : transformNodes)
+        d->reclaimer.retire([n]() { delete n; });
+    d->reclaimer.collect();
+}
+
+// Adds a resolved entry to the profile map and ends its build. The caller must hold the mutex.
+static profileEntry *addProfile(const profileBuild &build, std::unique_ptr<profileEntry> entry, uint64_t now, icccData *d)
+{
+    // Profile entries are accounted to their transform
+    size_t entryBytes = sizeof(profileEntry) + entry->error.size();
+    d->cacheBytes += entryBytes;
+    if (entry->transform)
+    {
+        entry->transform->footprint += entryBytes;
+        entry->transform->lastUsed.store(now, std::memory_order_relaxed);
+    }
+    else
+        ++d->failedProfiles;
+    profileEntry *result = entry.release();
+    d->profiles.insert(build.key, result);
+    d->pending.erase(build.key);
+    trimCache(d, result->transform);
+    return result;
+}
+
+// Parses an embedded profile and finds or creates its transform, the transform is built without holding the mutex.
+// Returns the new entry, which is in the profile map when this returns.
+static profileEntry *resolveProfile(const profileBuild &build, icccData *d)
+{
+    std::unique_ptr<profileEntry> entry(new profileEntry(build.key));
+    std::unique_ptr<transformData> created;
+    // Closed however this returns, building the transform may throw
+    std::unique_ptr<void, decltype(&cmsCloseProfile)> opened(cmsOpenProfileFromMem(build.data.data(), static_cast<cmsUInt32Number>(build.data.size())), cmsCloseProfile);
+    cmsHPROFILE inp = opened.get();
+    if (!inp)
+        entry->error = "iccc: Unable to read embedded ICC profile. Corrupted?";
+    else if ((cmsGetDeviceClass(inp) != cmsSigDisplayClass) && (cmsGetDeviceClass(inp) != cmsSigInputClass))
+        entry->error = "iccc: The device class of the embedded ICC profile is not supported.";
+    else if (cmsGetColorSpace(inp) != d->inputSpace)
+        entry->error = "iccc: The colorspace of the embedded ICC profile is not supported.";
+
+    std::unique_ptr<inputICCData> ind;
+    if (entry->error.empty())
+    {
+        // Different bytes may still be the same profile, e.g. with another creation date
+        ind.reset(new inputICCData(inp, cmsGetHeaderRenderingIntent(inp)));
+        bool known;
+        {
+            std::lock_guard<std::mutex> lock(d->mutex);
+            known = d->transforms.find(*ind) != nullptr;
+        }
+        if (!known)
+        {
+            cmsUInt32Number inputID[4];
+            getProfileID(ind->profile, inputID);
+            created.reset(createTransform(ind->profile, inputID, d->outputProfile, d->outputID, d->proofingProfile ? d->intent : ind->intent, d));
+            if (!created)
+                entry->error = "iccc: Failed to create transform from embedded ICC profile.";
+        }
+    }
+    opened.reset();
+
+    std::lock_guard<std::mutex> lock(d->mutex);
+    uint64_t now = d->cacheClock.fetch_add(1) + 1;
+    entry->added = now;
+    if (ind)
+    {
+        // Look again, it may have been evicted or added in the meantime
+        entry->transform = d->transforms.find(*ind);
+        if (entry->transform)
+            entry->error.clear();
+        else if (created)
+        {
+            entry->transform = created.release();
+            d->transforms.insert(*ind, entry->transform);
+            d->cacheBytes += entry->transform->footprint;
+        }
+        else if (entry->error.empty())
+        {
+            // Found before and evicted since, the next one who asks builds it again
+            d->pending.erase(build.key);
+            return nullptr;
+        }
+    }
+
+    return addProfile(build, std::move(entry), now, d);
+}
+
+// Records a build that threw as a failed profile, so the frames waiting for it get an error instead of hanging
+static profileEntry *failBuild(const profileBuild &build, const char *what, icccData *d)
+{
+    std::unique_ptr<profileEntry> entry(new profileEntry(build.key));
+    entry->error = std::string("iccc: Failed to resolve embedded ICC profile: ") + what;
     std::lock_guard<std::mutex> lock(d->mutex);
-    auto found = d->transformMap.find(ind);
-    if (found == d->transformMap.end())
+    uint64_t now = d->cacheClock.fetch_add(1) + 1;
+    entry->added = now;
+    // It may have been added before the build threw
+    profileEntry *existing = d->profiles.find(build.key);
+    if (existing)
     {
-        cmsHTRANSFORM transform;
-        if (d->proofingProfile)
+        d->pending.erase(build.key);
+        return existing;
+    }
+    return addProfile(build, std::move(entry), now, d);
+}
+
+// Resolves a build unless another thread already started it, then waits for the result
+static profileEntry *runBuild(profileBuild &build, icccData *d)
+{
+    if (!build.started.exchange(true))
+    {
+        try
+        {
+            build.promise.set_value(resolveProfile(build, d));
+        }
+        catch (const std::exception &e)
         {
-            transform = cmsCreateProofingTransform(ind.profile, d->inputDataType, d->outputProfile, d->outputDataType, d->proofingProfile, d->intent, d->proofingIntent, d->transformFlag);
+            build.promise.set_value(failBuild(build, e.what(), d));
         }
+        catch (...)
+        {
+            build.promise.set_value(failBuild(build, "unknown error", d));
+        }
+    }
+    return build.result.get();
+}
+
+// Returns the build of a profile that isn't in the map yet, starting a new one if needed.
+// The caller must hold the mutex.
+static std::shared_ptr<profileBuild> findBuild(const char *data, size_t size, const profileBlobKey &key, icccData *d)
+{
+    auto it = d->pending.find(key);
+    if (it != d->pending.end()) return it->second;
+    std::shared_ptr<profileBuild> build = std::make_shared<profileBuild>(data, size, key);
+    d->pending.emplace(key, build);
+    return build;
+}
+
+// Finds what an embedded profile resolves to if it's known, without parsing it
+static profileEntry *findProfile(const char *data, size_t size, icccData *d)
+{
+    profileEntry *last = d->lastProfile.load(std::memory_order_acquire);
+
+    // Same buffer as last time, trusted if the header and its profile ID are the same
+    if (last && last->lastData.load(std::memory_order_relaxed) == data && last->key.size == size && size >= profileBlobKey::headerSize)
+    {
+        static const uint8_t noID[16] = {};
+        if (memcmp(last->key.header, data, profileBlobKey::headerSize) == 0 && memcmp(last->key.header + 84, noID, sizeof(noID)) != 0)
+            return last;
+    }
+    return d->profiles.find(profileBlobKey(data, size));
+}
+
+// Finds or creates what an embedded profile resolves to. Repeated profiles are matched by their raw bytes,
+// so they are only parsed and hashed by lcms the first time. A new profile is resolved by the first frame
+// that needs it unless the background queue got to it first, other frames only wait if they need the same one.
+// The caller must hold an epochGuard until it's done with the result.
+static const profileEntry *getProfile(const char *data, size_t size, icccData *d)
+{
+    profileEntry *entry = findProfile(data, size, d);
+    d->stats->add(entry ? d->stats->cacheHits : d->stats->cacheMisses, 1);
+
+    while (!entry)
+    {
+        profileBlobKey key(data, size);
+        std::shared_ptr<profileBuild> build;
+        {
+            // Look again under the lock, another frame may have just added it
+            std::lock_guard<std::mutex> lock(d->mutex);
+            entry = d->profiles.find(key);
+            if (!entry)
+                build = findBuild(data, size, key, d);
+        }
+        if (build)
+            entry = runBuild(*build, d);
+    }
+
+    if (entry->transform)
+    {
+        uint64_t now = d->cacheClock.load(std::memory_order_relaxed);
+        if (entry->transform->lastUsed.load(std::memory_order_relaxed) != now)
+            entry->transform->lastUsed.store(now, std::memory_order_relaxed);
+    }
+    if (entry->lastData.load(std::memory_order_relaxed) != data)
+        entry->lastData.store(data, std::memory_order_relaxed);
+    if (d->lastProfile.load(std::memory_order_relaxed) != entry)
+        d->lastProfile.store(entry, std::memory_order_release);
+    return entry;
+}
+
+// Queues an embedded profile for the background queue unless it's known or already queued
+static void prefetchProfile(const char *data, size_t size, icccData *d)
+{
+    if (findProfile(data, size, d)) return;
+
+    profileBlobKey key(data, size);
+    std::lock_guard<std::mutex> lock(d->mutex);
+    if (d->profiles.find(key) || d->pending.count(key)) return;
+    std::shared_ptr<profileBuild> build = findBuild(data, size, key, d);
+    d->builder->post([build, d]() { runBuild(*build, d); });
+}
+
+// Cache budget for the working set of one strip of rows
+static size_t getCacheSize()
+{
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    static const size_t cacheSize = p2p::simd::cpu_cache_size_x86();
+    if (cacheSize > 0) return cacheSize;
+#endif
+    return 256 * 1024;
+}
+
+// Number of rows such that planes and interleave buffers of a strip stay in cache
+static int getStripHeight(size_t rowBytes, int height)
+{
+    size_t lines = getCacheSize() / 2 / std::max<size_t>(rowBytes, 1);
+    return static_cast<int>(std::max<size_t>(1, std::min<size_t>(lines, height)));
+}
+
+// Sets up the row band workers, returns false on invalid input
+static bool createWorkers(int threads, int coreThreads, icccData *d)
+{
+    if (threads < 0) return false;
+
+    d->coreThreads = std::max(coreThreads, 1);
+
+    // Never use more threads than the core itself, 0 means as many
+    if (threads == 0 || threads > d->coreThreads) threads = d->coreThreads;
+    if (threads > 1)
+        d->workers.reset(new workerPool(threads - 1));
+    return true;
+}
+
+// Reads the engine option, returns false on invalid input
+static bool getEngine(const char *engine, icccData *d)
+{
+    if (!engine || strcmp(engine, "auto") == 0)
+        d->engine = engineType::automatic;
+    else if (strcmp(engine, "lcms") == 0)
+        d->engine = engineType::lcms;
+    else if (strcmp(engine, "lut") == 0)
+        d->engine = engineType::lut;
+    else
+        return false;
+    return true;
+}
+
+// Reads the interleave layout, "auto" if not given
+static bool getLayout(const char *layout, icccData *d)
+{
+    if (!layout || strcmp(layout, "auto") == 0)
+        d->layout = layoutType::automatic;
+    else if (strcmp(layout, "packed") == 0)
+        d->layout = layoutType::packed;
+    else if (strcmp(layout, "planar") == 0)
+        d->layout = layoutType::planar;
+    else if (strcmp(layout, "padded") == 0)
+        d->layout = layoutType::padded;
+    else
+        return false;
+    return true;
+}
+
+// Reads the dither of reduced output, "none" if not given
+static bool getDither(const char *dither, icccData *d)
+{
+    if (!dither || strcmp(dither, "none") == 0)
+        d->dither = ditherType::none;
+    else if (strcmp(dither, "ordered") == 0)
+        d->dither = ditherType::ordered;
+    else if (strcmp(dither, "blue_noise") == 0)
+        d->dither = ditherType::blueNoise;
+    else if (strcmp(dither, "error_diffusion") == 0)
+        d->dither = ditherType::errorDiffusion;
+    else
+        return false;
+    return true;
+}
+
+// Reads the disk cache option, returns false if it's on but there is no directory for it
+static bool getDiskCache(bool diskCache, icccData *d)
+{
+    if (!diskCache) return true;
+    d->diskCacheDir = getDiskCacheDir();
+    return !d->diskCacheDir.empty();
+}
+
+// Distance between evenly spaced planes, or 0 if lcms can't address them as one planar buffer.
+// A single gray plane has no distance to keep, any will do.
+static size_t getPlaneDistance(const uint8_t * const planes[3], int numPlanes)
+{
+    if (numPlanes == 1) return 1;
+    uintptr_t a0 = reinterpret_cast<uintptr_t>(planes[0]);
+    uintptr_t a1 = reinterpret_cast<uintptr_t>(planes[1]);
+    uintptr_t a2 = reinterpret_cast<uintptr_t>(planes[2]);
+    if (a1 <= a0 || a2 - a1 != a1 - a0 || a1 - a0 > UINT32_MAX) return 0;
+    return a1 - a0;
+}
+
+// Samples per pixel in the interleave buffer, the padded packings carry an unused alpha
+static int getPackedChannels(p2p_packing packing)
+{
+    return packing == p2p_argb32 || packing == p2p_argb64 ? 4 : 3;
+}
+
+// Best time of converting a synthetic strip, interleaved by p2p or in place if packing is p2p_packing_max
+static double timeLayout(cmsHTRANSFORM transform, p2p_packing packing, int width, int bytesPerSample, std::vector<uint8_t> &dst)
+{
+    constexpr int lines = 16;
+    size_t stride = (static_cast<size_t>(width) * bytesPerSample + 63) & ~static_cast<size_t>(63);
+    size_t planeSize = stride * lines;
+    int channels = getPackedChannels(packing);
+    std::vector<uint8_t> src(planeSize * 3), buffer(packing == p2p_packing_max ? 0 : planeSize * channels);
+    dst.assign(planeSize * 3, 0);
+    uint32_t seed = 1;
+    for (auto &v : src)
+    {
+        seed = seed * 1664525 + 1013904223;
+        v = static_cast<uint8_t>(seed >> 24);
+    }
+
+    p2p_buffer_param p2p_src = {};
+    p2p_buffer_param p2p_dst = {};
+    for (int p = 0; p < 3; ++p)
+    {
+        p2p_src.src[p] = &src[p * planeSize];
+        p2p_src.src_stride[p] = stride;
+        p2p_dst.dst[p] = &dst[p * planeSize];
+        p2p_dst.dst_stride[p] = stride;
+    }
+    p2p_src.dst[0] = buffer.data();
+    p2p_dst.src[0] = buffer.data();
+    p2p_src.dst_stride[0] = p2p_dst.src_stride[0] = stride * channels;
+    p2p_src.width = p2p_dst.width = width;
+    p2p_src.height = p2p_dst.height = lines;
+    p2p_src.packing = p2p_dst.packing = packing;
+
+    double best = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (packing == p2p_packing_max)
+            cmsDoTransformLineStride(transform, src.data(), dst.data(), width, lines, stride, stride, planeSize, planeSize);
         else
         {
-            transform = cmsCreateTransform(ind.profile, d->inputDataType, d->outputProfile, d->outputDataType, ind.intent, d->transformFlag);
+            p2p_pack_frame(&p2p_src, 0);
+            cmsDoTransformLineStride(transform, buffer.data(), buffer.data(), width, lines, stride * channels, stride * channels, planeSize, planeSize);
+            p2p_unpack_frame(&p2p_dst, 0);
         }
-        if (transform)
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        // The first round only warms up caches
+        if (i == 1 || (i > 1 && elapsed < best)) best = elapsed;
+    }
+    return best;
+}
+
+// Creates the default transform of the filter, returns nullptr on failure. When it's left to lcms, its interleave layout
+// is the fastest of packed, planar and padded among those that give the same output as packed. lcms only optimizes
+// some pipelines for some layouts, e.g. 8 bit prelinearization, so they are compared with the real profiles, intent and
+// flags. Embedded profiles may be optimized differently, so filters that read them keep the packed layout.
+// The choice is made once per key.
+static transformData *createDefaultTransform(icccData *d, cmsHPROFILE input, const cmsUInt32Number inputID[4], cmsHPROFILE output, const cmsUInt32Number outputID[4])
+{
+    int bytesPerSample = d->rgbFormat.bytesPerSample;
+    cmsUInt32Number planarType = bytesPerSample == 1 ? TYPE_RGB_8_PLANAR : TYPE_RGB_16_PLANAR;
+    cmsUInt32Number paddedType = bytesPerSample == 1 ? TYPE_BGRA_8 : TYPE_BGRA_16;
+    p2p_packing paddedP2PType = bytesPerSample == 1 ? p2p_argb32 : p2p_argb64;
+    auto setLayout = [d](cmsUInt32Number type, p2p_packing p2pType)
+    {
+        d->inputDataType = d->outputDataType = type;
+        d->inputP2PType = d->outputP2PType = p2pType;
+    };
+
+    // Float is always planar, and the LUT engine always reads the planes
+    bool interleaved = d->engine != engineType::lut && d->inputP2PType != p2p_packing_max && d->outputP2PType != p2p_packing_max;
+    // A forced layout is taken as is, to measure it
+    if (interleaved && d->layout == layoutType::planar)
+        setLayout(planarType, p2p_packing_max);
+    else if (interleaved && d->layout == layoutType::padded)
+        setLayout(paddedType, paddedP2PType);
+    if (!interleaved || d->layout != layoutType::automatic || d->preferProps || !input || !output)
+        return createTransform(input, inputID, output, outputID, d->intent, d);
+
+    transformKey key;
+    bool shareable = getTransformKey(inputID, outputID, d->intent, d, key);
+    transformRegistry &registry = getRegistry();
+    bool chosen = false;
+    if (shareable)
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.layouts.find(key);
+        if (it != registry.layouts.end())
+        {
+            setLayout(it->second.type, it->second.p2pType);
+            chosen = true;
+        }
+    }
+    if (chosen)
+        return createTransform(input, inputID, output, outputID, d->intent, d);
+
+    // The engine is picked first, only transforms left to lcms read the interleave buffer
+    std::unique_ptr<transformData> packed(createTransform(input, inputID, output, outputID, d->intent, d));
+    if (!packed || packed->shared->engine)
+        return packed.release();
+
+    layoutChoice best = {d->inputDataType, d->inputP2PType};
+    cmsHTRANSFORM planar = createLcmsTransform(input, planarType, output, planarType, d->intent, d->transformFlag, d);
+    cmsHTRANSFORM padded = createLcmsTransform(input, paddedType, output, paddedType, d->intent, d->transformFlag, d);
+
+    // Variable resolution clips are timed with 1080p rows
+    int width = d->vi.width > 0 ? d->vi.width : 1920;
+    std::vector<uint8_t> packedResult, result;
+    double bestTime = timeLayout(packed->shared->transform, d->inputP2PType, width, bytesPerSample, packedResult);
+    auto consider = [&](cmsHTRANSFORM transform, cmsUInt32Number type, p2p_packing p2pType)
+    {
+        if (!transform) return;
+        double time = timeLayout(transform, p2pType, width, bytesPerSample, result);
+        if (time < bestTime && result == packedResult)
         {
-            d->transformMap[ind] = transform;
-            return transform;
+            bestTime = time;
+            best = {type, p2pType};
         }
-        else return nullptr;
+    };
+    consider(planar, planarType, p2p_packing_max);
+    consider(padded, paddedType, paddedP2PType);
+    if (planar) cmsDeleteTransform(planar);
+    if (padded) cmsDeleteTransform(padded);
+
+    // The first choice stored for the key is taken, so all instances use the same layout
+    if (shareable)
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        best = registry.layouts.emplace(key, best).first->second;
     }
-    else return found->second;
+    if (best.type == d->inputDataType)
+        return packed.release();
+    setLayout(best.type, best.p2pType);
+    return createTransform(input, inputID, output, outputID, d->intent, d);
 }
 
 struct PresetProfile
@@ -172,168 +1123,533 @@ static PresetProfile createPresetProfile(const char *name)
     }
     else if (strcmp(name, "xyz") == 0 || strcmp(name, "XYZ") == 0)
     {
-        pp.primaries = VSC_PRIMARIES_ST428;
-        pp.transfer = VSC_TRANSFER_LINEAR;
-        cmsCIExyYTRIPLE prim = {
-            {1.0, 0.0, 1.0},
-            {0.0, 1.0, 1.0},
-            {0.0, 0.0, 1.0},
-        };
-        cmsFloat64Number paramsX[3] = {1.0, 1.0 / cmsD50X, 0.0};
-        cmsFloat64Number paramsZ[3] = {1.0, 1.0 / cmsD50Z, 0.0};
-        cmsToneCurve *curveX = cmsBuildParametricToneCurve(nullptr, 2, paramsX);
-        cmsToneCurve *curveY = cmsBuildGamma(nullptr, 1.0);
-        cmsToneCurve *curveZ = cmsBuildParametricToneCurve(nullptr, 2, paramsZ);
-        cmsToneCurve *curves[3] = {curveX, curveY, curveZ};
-        pp.profile = cmsCreateRGBProfile(cmsD50_xyY(), &prim, curves);
-        cmsFreeToneCurve(curveX);
-        cmsFreeToneCurve(curveY);
-        cmsFreeToneCurve(curveZ);
-        cmsSetHeaderRenderingIntent(pp.profile, INTENT_RELATIVE_COLORIMETRIC);
-        cmsSetPCS(pp.profile, cmsSigXYZData);
-        cmsSetHeaderAttributes(pp.profile, cmsTransparency);
+        pp.primaries = VSC_PRIMARIES_ST428;
+        pp.transfer = VSC_TRANSFER_LINEAR;
+        cmsCIExyYTRIPLE prim = {
+            {1.0, 0.0, 1.0},
+            {0.0, 1.0, 1.0},
+            {0.0, 0.0, 1.0},
+        };
+        cmsFloat64Number paramsX[3] = {1.0, 1.0 / cmsD50X, 0.0};
+        cmsFloat64Number paramsZ[3] = {1.0, 1.0 / cmsD50Z, 0.0};
+        cmsToneCurve *curveX = cmsBuildParametricToneCurve(nullptr, 2, paramsX);
+        cmsToneCurve *curveY = cmsBuildGamma(nullptr, 1.0);
+        cmsToneCurve *curveZ = cmsBuildParametricToneCurve(nullptr, 2, paramsZ);
+        cmsToneCurve *curves[3] = {curveX, curveY, curveZ};
+        pp.profile = cmsCreateRGBProfile(cmsD50_xyY(), &prim, curves);
+        cmsFreeToneCurve(curveX);
+        cmsFreeToneCurve(curveY);
+        cmsFreeToneCurve(curveZ);
+        cmsSetHeaderRenderingIntent(pp.profile, INTENT_RELATIVE_COLORIMETRIC);
+        cmsSetPCS(pp.profile, cmsSigXYZData);
+        cmsSetHeaderAttributes(pp.profile, cmsTransparency);
+    }
+    return pp;
+}
+
+bool readProfile(const char *name, std::vector<char> &blob)
+{
+    std::ifstream file(name, std::ios::binary);
+    if (file)
+    {
+        blob.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        cmsHPROFILE profile = cmsOpenProfileFromMem(blob.data(), static_cast<cmsUInt32Number>(blob.size()));
+        if (profile)
+        {
+            cmsCloseProfile(profile);
+            return true;
+        }
+    }
+
+    PresetProfile pp = createPresetProfile(name);
+    if (!pp.profile) return false;
+    cmsUInt32Number size = 0;
+    bool saved = cmsSaveProfileToMem(pp.profile, nullptr, &size) && size > 0;
+    if (saved)
+    {
+        blob.resize(size);
+        saved = cmsSaveProfileToMem(pp.profile, blob.data(), &size);
+    }
+    cmsCloseProfile(pp.profile);
+    return saved;
+}
+
+// Convert and Playback as VapourSynth filters
+struct icccFilter
+{
+    VSNode *node = nullptr;
+    icccData *data = nullptr;
+    bool statsProps = false;
+};
+
+// Finds the transform of a frame with the given embedded profile if props are preferred, or the default one.
+// The caller must hold an epochGuard until it's done with the result. Returns nullptr and sets the error on failure.
+static const transformData *findTransform(icccData *d, const char *iccData, size_t iccSize, std::string &error)
+{
+    const transformData *transform = d->defaultTransform;
+
+    if (d->preferProps && iccData && iccSize > 0)
+    {
+        const profileEntry *entry = getProfile(iccData, iccSize, d);
+        if (!entry->transform)
+        {
+            error = entry->error;
+            return nullptr;
+        }
+        transform = entry->transform;
+    }
+
+    if (!transform)
+        error = "iccc: Failed to construct transform. This may be caused by insufficient ICC profile info provided.";
+    return transform;
+}
+
+// Converts one frame with the given transform. Returns false and sets the error on failure.
+static bool runTransform(icccData *d, const framePlanes &frame, const transformData *transform, std::string &error)
+{
+    const VSVideoFormat *srcFormat = &d->inputFormat;
+    const VSVideoFormat *rgbFormat = &d->rgbFormat;
+    int width = frame.width;
+    int height = frame.height;
+    ptrdiff_t srcStride = frame.srcStride;
+    ptrdiff_t dstStride = frame.dstStride;
+    // YUV output is encoded from planar RGB rows in the buffer, as wide as the source rows, and so is reduced output
+    bool encode = d->vi.format.colorFamily == cfYUV;
+    bool reduce = d->reducedBits > 0;
+    ptrdiff_t rgbStride = encode || reduce ? srcStride : dstStride;
+
+    // YUV is decoded into the buffer as planar RGB with the samples of the output
+    bool yuv = srcFormat->colorFamily == cfYUV;
+    yuvDecoder decoder;
+    if (yuv && !decoder.init(*srcFormat, width, frame.matrix >= 0 && frame.matrix != VSC_MATRIX_UNSPECIFIED ? frame.matrix : d->matrix, frame.range == VSC_RANGE_FULL))
+    {
+        error = "iccc: Only the BT.709, BT.601, BT.2020 NCL, FCC and SMPTE 240M matrices are supported for YUV input.";
+        return false;
+    }
+
+    const sharedTransform *shared = transform->shared.get();
+
+    // The transform runs in place unless the buffer layouts differ
+    bool needDstBuffer = d->inputDataType != d->outputDataType;
+    // Planar formats are copied into the buffer plane by plane, others are interleaved by p2p
+    bool srcPlanar = d->inputP2PType == p2p_packing_max;
+    bool dstPlanar = d->outputP2PType == p2p_packing_max;
+    int srcChannels = srcPlanar ? srcFormat->numPlanes : getPackedChannels(d->inputP2PType);
+    int dstChannels = dstPlanar ? rgbFormat->numPlanes : getPackedChannels(d->outputP2PType);
+    // Half floats take twice their size in the buffer
+    int widen = d->halfToFloat ? 2 : 1;
+    size_t srcBufferStride = (srcPlanar ? srcStride : srcStride * srcChannels) * widen;
+    size_t dstBufferStride = (dstPlanar ? rgbStride : rgbStride * dstChannels) * widen;
+
+    const uint8_t * const *srcPlanes = frame.src;
+    uint8_t * const *dstPlanes = frame.dst;
+
+    // Planar transforms read and write the frame planes in place when they are evenly spaced
+    size_t srcPlaneDistance = srcPlanar ? getPlaneDistance(srcPlanes, srcFormat->numPlanes) : 0;
+    size_t dstPlaneDistance = dstPlanar ? getPlaneDistance(dstPlanes, rgbFormat->numPlanes) : 0;
+    bool scaled = d->scaledBits > 0;
+    bool direct = srcPlaneDistance > 0 && dstPlaneDistance > 0 && !d->halfToFloat && !scaled && !reduce && !yuv && !encode;
+    // Engines read and write the frame planes unless they have to be decoded, scaled, reduced or encoded
+    bool buffered = !direct && (!shared->engine || scaled || reduce || yuv || encode);
+
+    // Working set per row: source planes, interleave buffer(s), destination planes
+    size_t rowBytes = srcStride * srcFormat->numPlanes + dstStride * d->vi.format.numPlanes;
+    if (buffered)
+        rowBytes += (srcStride * srcChannels + (needDstBuffer ? rgbStride * dstChannels : 0)) * widen;
+    // 4:2:0 output is encoded in pairs of rows, which strips and bands never split
+    int rowAlign = encode ? 1 << d->vi.format.subSamplingH : 1;
+    int stripHeight = std::max(getStripHeight(rowBytes, height) / rowAlign * rowAlign, rowAlign);
+
+    size_t srcBufferSize = srcStride * srcChannels * widen * stripHeight;
+    size_t dstBufferSize = needDstBuffer ? rgbStride * dstChannels * widen * stripHeight : 0;
+
+    int srcRowSize = width * srcFormat->bytesPerSample;
+    int dstRowSize = width * rgbFormat->bytesPerSample;
+
+    // Split into row bands only when the core has idle threads for them. Error diffusion runs from the top
+    // to the bottom, so that the result doesn't depend on the bands.
+    bool diffuse = reduce && d->dither == ditherType::errorDiffusion;
+    // Error carried to the next row, two rows per plane after the interleave buffers
+    size_t diffusionSize = diffuse ? (width + 2) * 2 * d->vi.format.numPlanes * sizeof(float) : 0;
+    int bands = 1;
+    if (d->workers)
+    {
+        int busy = d->activeFrames.fetch_add(1) + 1;
+        bands = std::min(d->workers->size() + 1, d->coreThreads - busy + 1);
+        bands = std::min(bands, (height + stripHeight - 1) / stripHeight);
+        bands = std::max(diffuse ? 1 : bands, 1);
+    }
+
+    std::atomic<bool> outOfMemory{false};
+
+    icccStats &stats = *d->stats;
+    auto elapsed = [](std::chrono::steady_clock::time_point &since)
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - since).count();
+        since = now;
+        return ns;
+    };
+
+    // Each band holds its own interleave buffer, one pack, transform and unpack per strip
+    auto convertBand = [&](int band)
+    {
+        int top = static_cast<int>(static_cast<int64_t>(height) * band / bands) / rowAlign * rowAlign;
+        int bottom = static_cast<int>(static_cast<int64_t>(height) * (band + 1) / bands) / rowAlign * rowAlign;
+        auto mark = std::chrono::steady_clock::now();
+
+        if (shared->engine && !scaled && !reduce && !yuv && !encode)
+        {
+            for (int h = top; h < bottom; ++h)
+            {
+                // Gray frames only have the first plane
+                const void *srcRow[3] = {};
+                void *dstRow[3] = {};
+                for (int p = 0; p < srcFormat->numPlanes; ++p)
+                    srcRow[p] = &srcPlanes[p][h * srcStride];
+                for (int p = 0; p < rgbFormat->numPlanes; ++p)
+                    dstRow[p] = &dstPlanes[p][h * dstStride];
+                shared->engine->apply(srcRow, dstRow, width);
+            }
+            stats.add(stats.transformNs, elapsed(mark));
+            return;
+        }
+
+        if (direct)
+        {
+            cmsDoTransformLineStride(shared->transform, &srcPlanes[0][top * srcStride], &dstPlanes[0][top * dstStride], width, bottom - top, srcStride, dstStride, srcPlaneDistance, dstPlaneDistance);
+            stats.add(stats.transformNs, elapsed(mark));
+            return;
+        }
+
+        scratchBuffer scratch = d->pool.acquire(srcBufferSize + dstBufferSize + diffusionSize, stats.bytesAllocated);
+        if (!scratch.data)
+        {
+            outOfMemory = true;
+            return;
+        }
+        uint8_t *srcBuffer = scratch.data;
+        uint8_t *dstBuffer = needDstBuffer ? srcBuffer + srcBufferSize : srcBuffer;
+        float *diffusion = diffuse ? reinterpret_cast<float *>(srcBuffer + srcBufferSize + dstBufferSize) : nullptr;
+        if (diffuse)
+            memset(diffusion, 0, diffusionSize);
+
+        p2p_buffer_param p2p_src = {};
+        p2p_src.width = width;
+        p2p_src.dst[0] = srcBuffer;
+        p2p_src.dst_stride[0] = srcBufferStride;
+        for (int p = 0; p < srcFormat->numPlanes; ++p)
+            p2p_src.src_stride[p] = srcStride;
+        p2p_src.packing = d->inputP2PType;
+
+        p2p_buffer_param p2p_dst = {};
+        p2p_dst.width = width;
+        p2p_dst.src[0] = dstBuffer;
+        p2p_dst.src_stride[0] = dstBufferStride;
+        for (int p = 0; p < rgbFormat->numPlanes; ++p)
+            p2p_dst.dst_stride[p] = dstStride;
+        p2p_dst.packing = d->outputP2PType;
+
+        // Summed per band, so that the counters are only touched once
+        uint64_t packNs = 0, transformNs = 0, unpackNs = 0;
+        for (int h = top; h < bottom; h += stripHeight)
+        {
+            int lines = std::min(stripHeight, bottom - h);
+            elapsed(mark);
+
+            if (yuv)
+            {
+                for (int y = 0; y < lines; ++y)
+                {
+                    void *rows[3];
+                    for (int p = 0; p < 3; ++p)
+                        rows[p] = &srcBuffer[(p * lines + y) * srcBufferStride];
+                    decoder.decodeRow(srcPlanes, srcStride, frame.srcChromaStride, h + y, height, rows);
+                }
+            }
+            else if (scaled)
+            {
+                for (int p = 0; p < srcFormat->numPlanes; ++p)
+                {
+                    for (int y = 0; y < lines; ++y)
+                        widenDepth(&srcPlanes[p][(h + y) * srcStride], reinterpret_cast<uint16_t *>(&srcBuffer[(p * lines + y) * srcBufferStride]), width, d->scaledBits);
+                }
+            }
+            else if (shared->engine)
+            {
+                // Engines read RGB frame planes in place
+            }
+            else if (d->halfToFloat)
+            {
+                for (int p = 0; p < srcFormat->numPlanes; ++p)
+                {
+                    for (int y = 0; y < lines; ++y)
+                        d->halfToFloat(&srcPlanes[p][(h + y) * srcStride], reinterpret_cast<float *>(&srcBuffer[(p * lines + y) * srcBufferStride]), width);
+                }
+            }
+            else if (srcPlanar)
+            {
+                for (int p = 0; p < srcFormat->numPlanes; ++p)
+                    vsh::bitblt(&srcBuffer[p * srcStride * lines], srcStride, &srcPlanes[p][h * srcStride], srcStride, srcRowSize, lines);
+            }
+            else
+            {
+                p2p_src.height = lines;
+                for (int p = 0; p < srcFormat->numPlanes; ++p)
+                    p2p_src.src[p] = &srcPlanes[p][h * srcStride];
+                p2p_pack_frame(&p2p_src, 0);
+            }
+            packNs += elapsed(mark);
+
+            if (shared->engine)
+            {
+                for (int y = 0; y < lines; ++y)
+                {
+                    const void *srcRow[3] = {};
+                    void *dstRow[3] = {};
+                    for (int p = 0; p < srcFormat->numPlanes; ++p)
+                        srcRow[p] = yuv || scaled ? &srcBuffer[(p * lines + y) * srcBufferStride] : &srcPlanes[p][(h + y) * srcStride];
+                    for (int p = 0; p < rgbFormat->numPlanes; ++p)
+                        dstRow[p] = encode || reduce ? &dstBuffer[(p * lines + y) * dstBufferStride] : &dstPlanes[p][(h + y) * dstStride];
+                    shared->engine->apply(srcRow, dstRow, width);
+                }
+                transformNs += elapsed(mark);
+                if (!encode && !reduce)
+                    continue;
+            }
+            else
+            {
+                cmsDoTransformLineStride(shared->transform, srcBuffer, dstBuffer, width, lines, srcBufferStride, dstBufferStride, srcStride * widen * lines, rgbStride * widen * lines);
+                transformNs += elapsed(mark);
+            }
+
+            if (encode)
+            {
+                for (int y = 0; y < lines; y += rowAlign)
+                {
+                    const void *rows[2][3];
+                    for (int p = 0; p < 3; ++p)
+                    {
+                        rows[0][p] = &dstBuffer[(p * lines + y) * dstBufferStride];
+                        rows[1][p] = &dstBuffer[(p * lines + y + rowAlign - 1) * dstBufferStride];
+                    }
+                    d->encoder.encodeRows(rows, dstPlanes, dstStride, frame.dstChromaStride, h + y, width);
+                }
+            }
+            else if (reduce)
+            {
+                for (int p = 0; p < rgbFormat->numPlanes; ++p)
+                {
+                    float *error = diffuse ? diffusion + (width + 2) * 2 * p : nullptr;
+                    for (int y = 0; y < lines; ++y)
+                        reduceDepth(reinterpret_cast<const uint16_t *>(&dstBuffer[(p * lines + y) * dstBufferStride]), &dstPlanes[p][(h + y) * dstStride], width, d->reducedBits, d->dither, h + y, p, error);
+                }
+            }
+            else if (d->floatToHalf)
+            {
+                for (int p = 0; p < rgbFormat->numPlanes; ++p)
+                {
+                    for (int y = 0; y < lines; ++y)
+                        d->floatToHalf(reinterpret_cast<const float *>(&dstBuffer[(p * lines + y) * dstBufferStride]), &dstPlanes[p][(h + y) * dstStride], width);
+                }
+            }
+            else if (dstPlanar)
+            {
+                for (int p = 0; p < rgbFormat->numPlanes; ++p)
+                    vsh::bitblt(&dstPlanes[p][h * dstStride], dstStride, &dstBuffer[p * dstStride * lines], dstStride, dstRowSize, lines);
+            }
+            else
+            {
+                p2p_dst.height = lines;
+                for (int p = 0; p < rgbFormat->numPlanes; ++p)
+                    p2p_dst.dst[p] = &dstPlanes[p][h * dstStride];
+                p2p_unpack_frame(&p2p_dst, 0);
+            }
+            unpackNs += elapsed(mark);
+        }
+        stats.add(stats.packNs, packNs);
+        stats.add(stats.transformNs, transformNs);
+        stats.add(stats.unpackNs, unpackNs);
+
+        d->pool.release(scratch);
+    };
+
+    if (bands > 1)
+        d->workers->run(bands, convertBand);
+    else
+        convertBand(0);
+
+    if (d->workers)
+        --d->activeFrames;
+
+    if (outOfMemory)
+    {
+        error = "iccc: Out of memory when constructing transform.";
+        return false;
     }
-    return pp;
+    stats.add(stats.frames, 1);
+    return true;
+}
+
+bool convertFrame(icccData *d, const framePlanes &frame, const char *iccData, size_t iccSize, std::string &error)
+{
+    // Cached transforms stay alive until the frame is done
+    epochGuard guard(d->preferProps ? &d->reclaimer : nullptr);
+    const transformData *transform = findTransform(d, iccData, iccSize, error);
+    return transform && runTransform(d, frame, transform, error);
+}
+
+const VSVideoInfo &getOutputInfo(const icccData *d)
+{
+    return d->vi;
+}
+
+const icccStats &getStats(const icccData *d)
+{
+    return *d->stats;
+}
+
+const char *getLayoutName(const icccData *d)
+{
+    if (d->inputP2PType == p2p_packing_max)
+        return "planar";
+    if (d->inputP2PType == p2p_argb32 || d->inputP2PType == p2p_argb64)
+        return "padded";
+    return "packed";
+}
+
+void freeConvert(icccData *d)
+{
+    unregisterStats(d->stats.get());
+    d->clear();
+    delete d;
 }
 
 static const VSFrame *VS_CC icccGetFrame(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi)
 {
-    icccData *d = reinterpret_cast<icccData *>(instanceData);
+    icccFilter *f = reinterpret_cast<icccFilter *>(instanceData);
+    icccData *d = f->data;
 
     if (activationReason == arInitial)
     {
-        vsapi->requestFrameFilter(n, d->node, frameCtx);
+        vsapi->requestFrameFilter(n, f->node, frameCtx);
+        for (int i = n + 1; i <= n + d->prefetch && i < d->vi.numFrames; ++i)
+            vsapi->requestFrameFilter(i, f->node, frameCtx);
     }
     else if (activationReason == arAllFramesReady)
     {
-        const VSFrame *srcFrame = vsapi->getFrameFilter(n, d->node, frameCtx);
-        const VSVideoFormat *srcFormat = vsapi->getVideoFrameFormat(srcFrame);
-        int width = vsapi->getFrameWidth(srcFrame, 0);
-        int height = vsapi->getFrameHeight(srcFrame, 0);
-        int srcStride = vsapi->getStride(srcFrame, 0);
+        const VSFrame *srcFrame = vsapi->getFrameFilter(n, f->node, frameCtx);
 
-        VSFrame *dstFrame = vsapi->newVideoFrame(&d->vi.format, width, height, srcFrame, core);
-        int dstStride = vsapi->getStride(dstFrame, 0);
-        VSMap *map = vsapi->getFramePropertiesRW(dstFrame);
+        framePlanes frame;
+        frame.width = vsapi->getFrameWidth(srcFrame, 0);
+        frame.height = vsapi->getFrameHeight(srcFrame, 0);
+        frame.srcStride = vsapi->getStride(srcFrame, 0);
 
-        auto filterError = [&](const char *msg)
+        // Clips of variable size are only checked here
+        bool encode = d->vi.format.colorFamily == cfYUV;
+        if (frame.width % (1 << d->vi.format.subSamplingW) || frame.height % (1 << d->vi.format.subSamplingH))
         {
             vsapi->freeFrame(srcFrame);
-            vsapi->freeFrame(dstFrame);
-            vsapi->setFilterError(msg, frameCtx);
+            vsapi->setFilterError("iccc: Frame dimensions must be multiples of the output chroma subsampling.", frameCtx);
             return nullptr;
-        };
+        }
 
-        // Create or find transform
-        cmsHTRANSFORM transform = d->defaultTransform;
-        if (d->preferProps)
+        // Profiles of the following frames are resolved in the background while this one is converted
+        for (int i = n + 1; i <= n + d->prefetch && i < d->vi.numFrames; ++i)
         {
+            const VSFrame *nextFrame = vsapi->getFrameFilter(i, f->node, frameCtx);
+            const VSMap *nextMap = vsapi->getFramePropertiesRO(nextFrame);
             int err;
-            int iccLength = vsapi->mapGetDataSize(map, "ICCProfile", 0, &err);
+            int iccLength = vsapi->mapGetDataSize(nextMap, "ICCProfile", 0, &err);
             if (!err && iccLength > 0)
-            {
-                const char *iccData = vsapi->mapGetData(map, "ICCProfile", 0, &err);
-                // Create profile
-                cmsHPROFILE inp = cmsOpenProfileFromMem(iccData, iccLength);
-                if (!inp)
-                    return filterError("iccc: Unable to read embedded ICC profile. Corrupted?");
-                // Sanity checks
-                if ((cmsGetDeviceClass(inp) != cmsSigDisplayClass) && (cmsGetDeviceClass(inp) != cmsSigInputClass))
-                    return filterError("iccc: The device class of the embedded ICC profile is not supported.");
-                if (cmsGetColorSpace(inp) != cmsSigRgbData)
-                    return filterError("iccc: The colorspace of the embedded ICC profile is not supported.");
-                inputICCData ind(inp, cmsGetHeaderRenderingIntent(inp));
-                transform = getTransform(ind, d);
-                cmsCloseProfile(inp);
-                if (!transform)
-                    return filterError("iccc: Failed to create transform from embedded ICC profile.");
-            }
+                prefetchProfile(vsapi->mapGetData(nextMap, "ICCProfile", 0, &err), iccLength, d);
+            vsapi->freeFrame(nextFrame);
         }
 
+        const VSMap *srcMap = vsapi->getFramePropertiesRO(srcFrame);
+        const char *iccData = nullptr;
+        int err;
+        int iccLength = vsapi->mapGetDataSize(srcMap, "ICCProfile", 0, &err);
+        if (!err && iccLength > 0)
+            iccData = vsapi->mapGetData(srcMap, "ICCProfile", 0, &err);
+
+        // Cached transforms stay alive until the frame is done
+        epochGuard guard(d->preferProps ? &d->reclaimer : nullptr);
+        std::string error;
+        const transformData *transform = findTransform(d, iccData, iccData ? iccLength : 0, error);
         if (!transform)
-            return filterError("iccc: Failed to construct transform. This may be caused by insufficient ICC profile info provided.");
-
-        uint8_t *srcBuffer = reinterpret_cast<uint8_t *>(vsh::vsh_aligned_malloc(srcStride * 1 * 3, 32));
-        uint8_t *dstBuffer = srcBuffer;
-        bool needDstBuffer = !vsh::isSameVideoFormat(srcFormat, &d->vi.format);
-        if (needDstBuffer)
-            dstBuffer = reinterpret_cast<uint8_t *>(vsh::vsh_aligned_malloc(dstStride * 1 * 3, 32));
-        if (!srcBuffer || !dstBuffer)
         {
-            if (srcBuffer) vsh::vsh_aligned_free(srcBuffer);
-            if (dstBuffer && needDstBuffer) vsh::vsh_aligned_free(dstBuffer);
-            return filterError("iccc: Out of memory when constructing transform.");
+            vsapi->freeFrame(srcFrame);
+            vsapi->setFilterError(error.c_str(), frameCtx);
+            return nullptr;
         }
 
-        std::vector<const uint8_t *> srcPlanes;
-        for (int p = 0; p < srcFormat->numPlanes; ++p)
-            srcPlanes.push_back(vsapi->getReadPtr(srcFrame, p));
-
-        std::vector<uint8_t *> dstPlanes;
-        for (int p = 0; p < d->vi.format.numPlanes; ++p)
-            dstPlanes.push_back(vsapi->getWritePtr(dstFrame, p));
-
-        int srcRowSize = width * srcFormat->bytesPerSample;
-        int dstRowSize = width * d->vi.format.bytesPerSample;
-
-        p2p_buffer_param p2p_src = {};
-        p2p_src.width = width;
-        p2p_src.height = 1;
-        p2p_src.dst[0] = srcBuffer;
-        p2p_src.dst_stride[0] = srcStride * 3;
-        for (int p = 0; p < srcFormat->numPlanes; ++p)
-            p2p_src.src_stride[p] = srcStride;
-        p2p_src.packing = d->inputP2PType;
-
-        p2p_buffer_param p2p_dst = {};
-        p2p_dst.width = width;
-        p2p_dst.height = 1;
-        p2p_dst.src[0] = dstBuffer;
-        p2p_dst.src_stride[0] = dstStride * 3;
-        for (int p = 0; p < d->vi.format.numPlanes; ++p)
-            p2p_dst.dst_stride[p] = dstStride;
-        p2p_dst.packing = d->outputP2PType;
-
-        for (int h = 0; h < height; ++h)
+        // Identity transforms only change the props, the planes are shared with the source frame
+        VSFrame *dstFrame;
+        if (d->passthrough && transform->shared->identity)
         {
-            if (d->inputP2PType == p2p_packing_max)
+            dstFrame = vsapi->copyFrame(srcFrame, core);
+            vsapi->freeFrame(srcFrame);
+            d->stats->add(d->stats->frames, 1);
+            d->stats->add(d->stats->passthroughFrames, 1);
+        }
+        else
+        {
+            dstFrame = vsapi->newVideoFrame(&d->vi.format, frame.width, frame.height, srcFrame, core);
+            frame.dstStride = vsapi->getStride(dstFrame, 0);
+            if (encode)
+                frame.dstChromaStride = vsapi->getStride(dstFrame, 1);
+
+            // Gray frames only have the first plane
+            for (int p = 0; p < 3; ++p)
             {
-                for (int p = 0; p < srcFormat->numPlanes; ++p)
-                    vsh::bitblt(&srcBuffer[p * srcStride * 1], srcStride, &srcPlanes[p][h * srcStride], srcStride, srcRowSize, 1);
+                frame.src[p] = p < d->inputFormat.numPlanes ? vsapi->getReadPtr(srcFrame, p) : nullptr;
+                frame.dst[p] = p < d->vi.format.numPlanes ? vsapi->getWritePtr(dstFrame, p) : nullptr;
             }
-            else
+            if (d->inputFormat.colorFamily == cfYUV)
             {
-                for (int p = 0; p < srcFormat->numPlanes; ++p)
-                    p2p_src.src[p] = &srcPlanes[p][h * srcStride];
-                p2p_pack_frame(&p2p_src, 0);
+                frame.srcChromaStride = vsapi->getStride(srcFrame, 1);
+                frame.matrix = vsh::int64ToIntS(vsapi->mapGetInt(srcMap, "_Matrix", 0, &err));
+                if (err) frame.matrix = -1;
+                frame.range = vsh::int64ToIntS(vsapi->mapGetInt(srcMap, "_ColorRange", 0, &err));
+                if (err) frame.range = -1;
             }
 
-            cmsDoTransformLineStride(transform, srcBuffer, dstBuffer, width, 1, srcStride * 3, dstStride * 3, srcStride * 1, dstStride * 1);
-
-            if (d->outputP2PType == p2p_packing_max)
-            {
-                for (int p = 0; p < d->vi.format.numPlanes; ++p)
-                    vsh::bitblt(&dstPlanes[p][h * dstStride], dstStride, &dstBuffer[p * dstStride * 1], dstStride, dstRowSize, 1);
-            }
-            else
+            bool converted = runTransform(d, frame, transform, error);
+            vsapi->freeFrame(srcFrame);
+            if (!converted)
             {
-                for (int p = 0; p < d->vi.format.numPlanes; ++p)
-                    p2p_dst.dst[p] = &dstPlanes[p][h * dstStride];
-                p2p_unpack_frame(&p2p_dst, 0);
+                vsapi->freeFrame(dstFrame);
+                vsapi->setFilterError(error.c_str(), frameCtx);
+                return nullptr;
             }
         }
 
-        vsh::vsh_aligned_free(srcBuffer);
-        if (needDstBuffer) vsh::vsh_aligned_free(dstBuffer);
-        vsapi->freeFrame(srcFrame);
-
         // Set frame props
+        VSMap *map = vsapi->getFramePropertiesRW(dstFrame);
         vsapi->mapSetInt(map, "_Primaries", d->primaries, maReplace);
         vsapi->mapSetInt(map, "_Transfer", d->transfer, maReplace);
         if (d->outputProfileData.size() > 0)
             vsapi->mapSetData(map, "ICCProfile", d->outputProfileData.data(), d->outputProfileData.size(), dtBinary, maReplace);
         else
             vsapi->mapDeleteKey(map, "ICCProfile");
+        if (encode)
+        {
+            vsapi->mapSetInt(map, "_Matrix", d->outputMatrix, maReplace);
+            vsapi->mapSetInt(map, "_ColorRange", d->vi.format.sampleType == stFloat ? VSC_RANGE_FULL : VSC_RANGE_LIMITED, maReplace);
+            if (d->vi.format.subSamplingW || d->vi.format.subSamplingH)
+                vsapi->mapSetInt(map, "_ChromaLocation", VSC_CHROMA_LEFT, maReplace);
+            else
+                vsapi->mapDeleteKey(map, "_ChromaLocation");
+        }
+        else if (d->inputFormat.colorFamily != d->vi.format.colorFamily)
+        {
+            vsapi->mapSetInt(map, "_Matrix", VSC_MATRIX_RGB, maReplace);
+            vsapi->mapSetInt(map, "_ColorRange", VSC_RANGE_FULL, maReplace);
+            vsapi->mapDeleteKey(map, "_ChromaLocation");
+        }
+        if (f->statsProps)
+            d->stats->setProps(map, vsapi);
 
         return dstFrame;
     }
@@ -342,81 +1658,246 @@ static const VSFrame *VS_CC icccGetFrame(int n, int activationReason, void *inst
 
 static void VS_CC icccFree(void *instanceData, VSCore *core, const VSAPI *vsapi)
 {
-    icccData *d = reinterpret_cast<icccData *>(instanceData);
-    vsapi->freeNode(d->node);
-    d->clear();
-    delete d;
+    icccFilter *f = reinterpret_cast<icccFilter *>(instanceData);
+    vsapi->freeNode(f->node);
+    if (f->data->stats->frames.load() > 0)
+        vsapi->logMessage(mtInformation, f->data->stats->summary().c_str(), core);
+    freeConvert(f->data);
+    delete f;
 }
 
-void VS_CC icccCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+// Frame format of the conversion, only RGB24, RGB48, RGBS and RGBH for now.
+// YUV is decoded to RGB of the same sample size, which is also the output format. Gray stays gray until setGrayOutput.
+static bool setDataTypes(icccData *d, const VSVideoFormat &inputFormat)
 {
-    std::unique_ptr<icccData> d(new icccData());
-
-    d->node = vsapi->mapGetNode(in, "clip", 0, nullptr);
-    const VSVideoInfo *vi = vsapi->getVideoInfo(d->node);
-    uint32_t srcFormat = vsapi->queryVideoFormatID(vi->format.colorFamily, vi->format.sampleType, vi->format.bitsPerSample, vi->format.subSamplingW, vi->format.subSamplingH, core);
-    d->vi = *vi;
-
-    cmsHPROFILE inputProfile = nullptr;
-
-    auto filterError = [&](const char *msg)
-    {
-        if (inputProfile) cmsCloseProfile(inputProfile);
-        if (d->outputProfile) cmsCloseProfile(d->outputProfile);
-        if (d->proofingProfile) cmsCloseProfile(d->proofingProfile);
-        vsapi->freeNode(d->node);
-        vsapi->mapSetError(out, msg);
-    };
-
-    if (srcFormat == pfRGB24)
+    VSVideoFormat format = inputFormat;
+    bool yuv = format.colorFamily == cfYUV;
+    bool gray = format.colorFamily == cfGray;
+    if (yuv && !getDecodedFormat(inputFormat, format))
+        return false;
+    if (format.colorFamily != cfRGB && !gray)
+        return false;
+    bool isFloat = format.sampleType == stFloat;
+    if (!isFloat && format.bitsPerSample == 8)
     {
         d->inputDataType = TYPE_BGR_8;
         d->outputDataType = d->inputDataType;
         d->inputP2PType = p2p_rgb24;
         d->outputP2PType = d->inputP2PType;
     }
-    else if (srcFormat == pfRGB48)
+    else if (!isFloat && format.bitsPerSample == 16)
     {
         d->inputDataType = TYPE_BGR_16;
         d->outputDataType = d->inputDataType;
         d->inputP2PType = p2p_rgb48;
         d->outputP2PType = d->inputP2PType;
     }
-    else if (srcFormat == pfRGBS)
+    else if (!isFloat && format.bitsPerSample > 8 && format.bitsPerSample < 16)
+    {
+        // Scaled to 16 bits plane by plane, so planar in the buffer
+        d->inputDataType = TYPE_RGB_16_PLANAR;
+        d->outputDataType = d->inputDataType;
+        d->scaledBits = format.bitsPerSample;
+        d->reducedBits = format.bitsPerSample;
+    }
+    else if (isFloat && (format.bitsPerSample == 32 || format.bitsPerSample == 16))
     {
         d->inputDataType = TYPE_RGB_FLT | PLANAR_SH(1);
         d->outputDataType = d->inputDataType;
+        if (format.bitsPerSample == 16)
+        {
+            d->halfToFloat = getHalfToFloat();
+            d->floatToHalf = getFloatToHalf();
+        }
 #ifdef USE_LCMS2_FAST_FLOAT
         cmsPlugin(cmsFastFloatExtensions());
 #endif
     }
     else
-        return filterError("iccc: Currently only RGB24, RGB48 and RGBS input formats are well supported.");
+        return false;
+    if (yuv && !isFloat)
+    {
+        // Decoded rows are planar
+        d->inputDataType = format.bytesPerSample == 1 ? TYPE_RGB_8_PLANAR : TYPE_RGB_16_PLANAR;
+        d->outputDataType = d->inputDataType;
+        d->inputP2PType = p2p_packing_max;
+        d->outputP2PType = p2p_packing_max;
+    }
+    if (gray)
+    {
+        // A single plane, read in place or copied like planar RGB
+        d->inputDataType = isFloat ? TYPE_GRAY_FLT : format.bytesPerSample == 1 ? TYPE_GRAY_8 : TYPE_GRAY_16;
+        d->outputDataType = d->inputDataType;
+        d->inputP2PType = p2p_packing_max;
+        d->outputP2PType = p2p_packing_max;
+        d->inputSpace = cmsSigGrayData;
+    }
+    d->inputFormat = inputFormat;
+    d->rgbFormat = format;
+    d->vi.format = format;
+    return true;
+}
+
+// Gray clips stay gray for gray display profiles, and are written straight to RGB planes for RGB ones.
+// False if the display profile is neither.
+static bool setGrayOutput(icccData *d)
+{
+    cmsColorSpaceSignature space = cmsGetColorSpace(d->outputProfile);
+    if (d->inputSpace != cmsSigGrayData)
+        return space == cmsSigRgbData;
+    if (space == cmsSigGrayData)
+        return true;
+    if (space != cmsSigRgbData)
+        return false;
+    d->rgbFormat.colorFamily = cfRGB;
+    d->rgbFormat.numPlanes = 3;
+    d->vi.format = d->rgbFormat;
+    if (T_FLOAT(d->inputDataType))
+        d->outputDataType = TYPE_RGB_FLT | PLANAR_SH(1);
+    else
+        d->outputDataType = d->rgbFormat.bytesPerSample == 1 ? TYPE_RGB_8_PLANAR : TYPE_RGB_16_PLANAR;
+    return true;
+}
 
-    int err;
+// Matrix of YUV clips that follows the primaries of a preset, BT.709 for anything else
+static VSMatrixCoefficients getDefaultMatrix(VSColorPrimaries primaries)
+{
+    if (primaries == VSC_PRIMARIES_BT470_BG || primaries == VSC_PRIMARIES_ST170_M)
+        return VSC_MATRIX_ST170_M;
+    if (primaries == VSC_PRIMARIES_BT2020)
+        return VSC_MATRIX_BT2020_NCL;
+    return VSC_MATRIX_BT709;
+}
+
+// Planar types for the output phase, which reads rows of each plane
+static void setPlanarTypes(icccData *d)
+{
+    if (d->inputP2PType == p2p_packing_max)
+        return;
+    d->inputDataType = d->rgbFormat.bytesPerSample == 1 ? TYPE_RGB_8_PLANAR : TYPE_RGB_16_PLANAR;
+    d->outputDataType = d->inputDataType;
+    d->inputP2PType = p2p_packing_max;
+    d->outputP2PType = p2p_packing_max;
+}
+
+// YUV or lower depth output from planar rows of the transform, the transform's own if the format is undefined
+static bool setOutputFormat(icccData *d, const VSVideoFormat &format)
+{
+    if (format.colorFamily == cfUndefined)
+        return true;
+    // Integer output of the same color family may have fewer bits, reduced from the transformed rows
+    if (format.colorFamily == d->rgbFormat.colorFamily)
+    {
+        if (format.sampleType != d->rgbFormat.sampleType || format.subSamplingW || format.subSamplingH)
+            return false;
+        if (format.sampleType == stFloat)
+            return format.bitsPerSample == d->vi.format.bitsPerSample;
+        if (format.bitsPerSample < 8 || format.bitsPerSample > d->vi.format.bitsPerSample)
+            return false;
+        if (format.bitsPerSample == d->vi.format.bitsPerSample)
+            return true;
+        setPlanarTypes(d);
+        d->reducedBits = format.bitsPerSample;
+        d->vi.format = format;
+        return true;
+    }
+    if (d->rgbFormat.colorFamily != cfRGB || !isEncodableFormat(d->rgbFormat, format))
+        return false;
+    // The encoder reads planar rows
+    setPlanarTypes(d);
+    // Half floats and scaled integers are encoded from the widened rows
+    VSVideoFormat rows = d->rgbFormat;
+    if (d->scaledBits)
+        rows.bitsPerSample = 16;
+    if (d->halfToFloat)
+    {
+        rows.bitsPerSample = 32;
+        rows.bytesPerSample = 4;
+        d->floatToHalf = nullptr;
+    }
+    d->outputMatrix = getDefaultMatrix(d->primaries);
+    d->encoder.init(rows, format, d->outputMatrix);
+    d->vi.format = format;
+    return true;
+}
+
+// Whether identity transforms can pass frames through, which needs RGB or gray output in the format of the input.
+// YUV frames are always converted, as the output is labeled with the matrix and range of the encoder, not those of the frame.
+static bool canPassThrough(const VSVideoFormat &a, const VSVideoFormat &b)
+{
+    return a.colorFamily != cfYUV && a.colorFamily == b.colorFamily && a.sampleType == b.sampleType && a.bitsPerSample == b.bitsPerSample &&
+        a.subSamplingW == b.subSamplingW && a.subSamplingH == b.subSamplingH;
+}
+
+// Serialized output profile for the frame props, left empty with a warning if that fails
+static void saveOutputProfile(icccData *d, cmsHPROFILE profile, std::vector<std::string> &warnings)
+{
+    cmsUInt32Number outputProfileSize = 0;
+    cmsSaveProfileToMem(profile, nullptr, &outputProfileSize);
+    if (outputProfileSize > 0)
+    {
+        d->outputProfileData.resize(outputProfileSize);
+        if(!cmsSaveProfileToMem(profile, d->outputProfileData.data(), &outputProfileSize))
+            d->outputProfileData.clear();
+    }
+    if (outputProfileSize <= 0 || d->outputProfileData.size() == 0)
+        warnings.push_back("iccc: Won't set ICC frame props.");
+}
+
+// Maps the clut_size option to grid points, returns 0 on invalid input
+static int getClutSize(int clutSize)
+{
+    if (clutSize == -1) return 17; // default for cmsFLAGS_LOWRESPRECALC
+    else if (clutSize == 0) return 33; // default
+    else if (clutSize == 1) return 49; // default for cmsFLAGS_HIGHRESPRECALC
+    else if ((clutSize < -1) || (clutSize > 255)) return 0;
+    return clutSize;
+}
+
+icccData *createConvert(const VSVideoInfo &vi, const convertArgs &args, int coreThreads, std::string &error, std::vector<std::string> &warnings)
+{
+    std::unique_ptr<icccData> d(new icccData());
+    d->vi = vi;
 
-    d->preferProps = vsapi->mapGetInt(in, "prefer_props", 0, &err) || err;
+    cmsHPROFILE inputProfile = nullptr;
+
+    auto filterError = [&](const char *msg) -> icccData *
+    {
+        if (inputProfile) cmsCloseProfile(inputProfile);
+        d->clear();
+        error = msg;
+        return nullptr;
+    };
+
+    if (!setDataTypes(d.get(), vi.format))
+        return filterError("iccc: Currently only 8 to 16 bit integer RGB or gray, RGBS, RGBH, GrayS, GrayH and YUV 4:4:4, 4:2:2 or 4:2:0 input formats are well supported.");
+    bool isFloat = vi.format.sampleType == stFloat;
 
-    const char *srcProfilePath = vsapi->mapGetData(in, "input_icc", 0, &err);
-    if (err || !srcProfilePath)
+    d->preferProps = args.preferProps;
+
+    const char *srcProfilePath = args.inputIcc;
+    if (!srcProfilePath)
         inputProfile = nullptr;
     else if (!(inputProfile = cmsOpenProfileFromFile(srcProfilePath, "r")))
     {
         PresetProfile pp = createPresetProfile(srcProfilePath);
         if (pp.profile)
+        {
             inputProfile = pp.profile;
+            d->matrix = getDefaultMatrix(pp.primaries);
+        }
         else
             return filterError("iccc: Input profile seems invalid.");
     }
     if (inputProfile && (cmsGetDeviceClass(inputProfile) != cmsSigDisplayClass) && (cmsGetDeviceClass(inputProfile) != cmsSigInputClass))
         return filterError("iccc: Input profile must have 'display' ('mntr') or 'input' ('scnr') device class.");
-    if (inputProfile && cmsGetColorSpace(inputProfile) != cmsSigRgbData)
-        return filterError("iccc: Input profile must be for RGB colorspace.");
+    if (inputProfile && cmsGetColorSpace(inputProfile) != d->inputSpace)
+        return filterError("iccc: Input profile must be for RGB colorspace, or gray for gray clips.");
     if (!d->preferProps && !inputProfile)
         return filterError("iccc: Input profile must be provided unless frame properties are preferred.");
 
-    const char *dstProfile = vsapi->mapGetData(in, "display_icc", 0, &err);
-    if (err || !dstProfile)
+    const char *dstProfile = args.displayIcc;
+    if (!dstProfile)
     {
         d->outputProfile = getSystemProfile();
         if (!d->outputProfile)
@@ -436,22 +1917,13 @@ void VS_CC icccCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
     }
     if ((cmsGetDeviceClass(d->outputProfile) != cmsSigDisplayClass) && (cmsGetDeviceClass(d->outputProfile) != cmsSigOutputClass))
         return filterError("iccc: Display (output) profile must have 'display' ('mntr') or 'output' ('prtr') device class.");
-    if (cmsGetColorSpace(d->outputProfile) != cmsSigRgbData)
-        return filterError("iccc: Display profile must be for RGB colorspace.");
+    if (!setGrayOutput(d.get()))
+        return filterError("iccc: Display profile must be for RGB colorspace, or gray for gray clips.");
 
-    cmsUInt32Number outputProfileSize = 0;
-    cmsSaveProfileToMem(d->outputProfile, nullptr, &outputProfileSize);
-    if (outputProfileSize > 0)
-    {
-        d->outputProfileData.resize(outputProfileSize);
-        if(!cmsSaveProfileToMem(d->outputProfile, d->outputProfileData.data(), &outputProfileSize))
-            d->outputProfileData.clear();
-    }
-    if (outputProfileSize <= 0 || d->outputProfileData.size() == 0)
-        vsapi->logMessage(mtWarning, "iccc: Won't set ICC frame props.", core);
+    saveOutputProfile(d.get(), d->outputProfile, warnings);
 
-    const char *intentString = vsapi->mapGetData(in, "intent", 0, &err);
-    if (err || !intentString)
+    const char *intentString = args.intent;
+    if (!intentString)
     {
         if (inputProfile)
             d->intent = cmsGetHeaderRenderingIntent(inputProfile);
@@ -464,9 +1936,9 @@ void VS_CC icccCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
         d->intent = itt;
     }
 
-    d->transformFlag = srcFormat == pfRGBS ? 0 : cmsFLAGS_NONEGATIVES;
+    d->transformFlag = isFloat ? 0 : cmsFLAGS_NONEGATIVES;
 
-    const char *proofingProfilePath = vsapi->mapGetData(in, "proofing_icc", 0, &err);
+    const char *proofingProfilePath = args.proofingIcc;
     if (proofingProfilePath)
     {
         if (!(d->proofingProfile = cmsOpenProfileFromFile(proofingProfilePath, "r")))
@@ -485,8 +1957,8 @@ void VS_CC icccCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
     const char *proofingIntentString = nullptr;
     if (d->proofingProfile)
     {
-        proofingIntentString = vsapi->mapGetData(in, "proofing_intent", 0, &err);
-        if (err || !proofingIntentString)
+        proofingIntentString = args.proofingIntent;
+        if (!proofingIntentString)
             d->proofingIntent = cmsGetHeaderRenderingIntent(d->proofingProfile);
         else
         {
@@ -497,105 +1969,123 @@ void VS_CC icccCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
         }
     }
 
-    bool gamutWarning = !!vsapi->mapGetInt(in, "gamut_warning", 0, &err);
-    if (gamutWarning)
+    if (args.gamutWarning)
     {
         d->transformFlag |= cmsFLAGS_GAMUTCHECK;
         assert(cmsMAXCHANNELS > 3);
         cmsUInt16Number gamutWarningColor[cmsMAXCHANNELS] = {65535, 0, 65535};
-        if (vsapi->mapNumElements(in, "gamut_warning_color") == 3)
+        if (args.gamutWarningColor.size() == 3)
             for (int i = 0; i < 3; ++i)
-                gamutWarningColor[i] = static_cast<cmsUInt16Number>(vsapi->mapGetInt(in, "gamut_warning_color", i, nullptr));
+                gamutWarningColor[i] = static_cast<cmsUInt16Number>(args.gamutWarningColor[i]);
         cmsSetAlarmCodes(gamutWarningColor);
     }
 
-    bool blackPointCompensation = !!vsapi->mapGetInt(in, "black_point_compensation", 0, &err);
-    if (blackPointCompensation)
+    if (args.blackPointCompensation)
         d->transformFlag |= cmsFLAGS_BLACKPOINTCOMPENSATION;
 
-    int clutSize = vsh::int64ToIntS(vsapi->mapGetInt(in, "clut_size", 0, &err));
-    if (err) clutSize = 1;
-    if (clutSize == -1) clutSize = 17; // default for cmsFLAGS_LOWRESPRECALC
-    else if (clutSize == 0) clutSize = 33; // default
-    else if (clutSize == 1) clutSize = 49; // default for cmsFLAGS_HIGHRESPRECALC
-    else if ((clutSize < -1) || (clutSize > 255))
+    int clutSize = getClutSize(args.clutSize);
+    if (!clutSize)
         return filterError("iccc: Input clut size seems invalid.");
     d->transformFlag |= cmsFLAGS_GRIDPOINTS(clutSize);
+    d->clutSize = clutSize;
+
+    if (!createWorkers(args.threads, coreThreads, d.get()))
+        return filterError("iccc: Input threads must not be negative.");
+
+    if (!getEngine(args.engine, d.get()))
+        return filterError("iccc: Input engine must be one of 'auto', 'lcms' and 'lut'.");
+    if (d->engine == engineType::lut && isFloat)
+        return filterError("iccc: The 'lut' engine only supports integer RGB.");
+    if (!getDiskCache(args.diskCache, d.get()))
+        return filterError("iccc: Unable to locate a directory for disk_cache.");
+
+    int64_t cacheMB = args.cacheMB;
+    if (cacheMB < 0)
+        return filterError("iccc: Input cache_mb must not be negative.");
+    d->cacheBudget = static_cast<size_t>(std::min<int64_t>(cacheMB, SIZE_MAX >> 20)) << 20;
+
+    int64_t prefetch = args.prefetch;
+    if (prefetch < 0 || prefetch > 64)
+        return filterError("iccc: Input prefetch must be between 0 and 64.");
+    if ((prefetch > 0 || !args.warmup.empty()) && !d->preferProps)
+        return filterError("iccc: Input prefetch and warmup need prefer_props.");
+    d->prefetch = static_cast<int>(prefetch);
+
+    // Warmup profiles are matched by their bytes like embedded ones, and by their profile ID if those differ
+    std::vector<std::vector<char>> warmup;
+    for (const char *name : args.warmup)
+    {
+        std::vector<char> blob;
+        if (!readProfile(name, blob))
+            return filterError("iccc: Warmup profile seems invalid.");
+        warmup.push_back(std::move(blob));
+    }
+
+    if (!getLayout(args.layout, d.get()))
+        return filterError("iccc: Input layout must be one of 'auto', 'packed', 'planar' and 'padded'.");
+    if (!getDither(args.dither, d.get()))
+        return filterError("iccc: Input dither must be one of 'none', 'ordered', 'blue_noise' and 'error_diffusion'.");
+    if (!setOutputFormat(d.get(), args.format))
+        return filterError("iccc: Output format must be integer RGB, or gray for gray output, of 8 bits up to the output depth, or YUV 4:4:4, 4:2:2 or 4:2:0 of the same sample type as the input, 8 to 16 bit integer or 32 bit float.");
+    if (vi.width % (1 << d->vi.format.subSamplingW) || vi.height % (1 << d->vi.format.subSamplingH))
+        return filterError("iccc: Frame dimensions must be multiples of the output chroma subsampling.");
+    d->passthrough = canPassThrough(d->inputFormat, d->vi.format);
+
+    cmsUInt32Number inputID[4];
+    getProfileID(inputProfile, inputID);
+    getProfileID(d->outputProfile, d->outputID);
+    getProfileID(d->proofingProfile, d->proofingID);
 
     // Create a default transform. If it's null, leave error report to the runtime.
     if (inputProfile)
     {
-        if (d->proofingProfile)
-            d->defaultTransform = cmsCreateProofingTransform(inputProfile, d->inputDataType, d->outputProfile, d->outputDataType, d->proofingProfile, d->intent, d->proofingIntent, d->transformFlag);
-        else
-            d->defaultTransform = cmsCreateTransform(inputProfile, d->inputDataType, d->outputProfile, d->outputDataType, d->intent, d->transformFlag);
+        d->defaultTransform = createDefaultTransform(d.get(), inputProfile, inputID, d->outputProfile, d->outputID);
         inputICCData ind(inputProfile, d->intent);
-        d->transformMap[ind] = d->defaultTransform;
+        if (d->defaultTransform)
+        {
+            d->transforms.insert(ind, d->defaultTransform);
+            d->cacheBytes += d->defaultTransform->footprint;
+        }
         cmsCloseProfile(inputProfile);
     }
     else
         d->defaultTransform = nullptr;
 
-    std::vector<VSFilterDependency> depReq = { {d->node, rpStrictSpatial} };
+    if (d->prefetch > 0 || !warmup.empty())
+    {
+        d->builder.reset(new backgroundQueue());
+        for (auto &blob : warmup)
+            prefetchProfile(blob.data(), blob.size(), d.get());
+    }
 
-    vsapi->createVideoFilter(out, "Convert", &d->vi, icccGetFrame, icccFree, fmParallel, depReq.data(), depReq.size(), d.get(), core);
-    d.release();
+    d->stats->filter = "Convert";
+    registerStats(d->stats);
+    return d.release();
 }
 
-// Playback won't respect frame properties for variable transforms. That's evil.
-void VS_CC iccpCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+icccData *createPlayback(const VSVideoInfo &vi, const playbackArgs &args, int coreThreads, std::string &error, std::vector<std::string> &warnings)
 {
     std::unique_ptr<icccData> d(new icccData());
-
-    d->node = vsapi->mapGetNode(in, "clip", 0, nullptr);
-    const VSVideoInfo *vi = vsapi->getVideoInfo(d->node);
-    d->vi = *vi;
-
-    uint32_t srcFormat = vsapi->queryVideoFormatID(vi->format.colorFamily, vi->format.sampleType, vi->format.bitsPerSample, vi->format.subSamplingW, vi->format.subSamplingH, core);
+    d->vi = vi;
 
     cmsHPROFILE inputProfile = nullptr;
 
-    auto filterError = [&](const char *msg)
+    auto filterError = [&](const char *msg) -> icccData *
     {
         if (inputProfile) cmsCloseProfile(inputProfile);
-        if (d->outputProfile) cmsCloseProfile(d->outputProfile);
-        vsapi->freeNode(d->node);
-        vsapi->mapSetError(out, msg);
+        d->clear();
+        error = msg;
+        return nullptr;
     };
 
-    if (srcFormat == pfRGB24)
-    {
-        d->inputDataType = TYPE_BGR_8;
-        d->outputDataType = d->inputDataType;
-        d->inputP2PType = p2p_rgb24;
-        d->outputP2PType = d->inputP2PType;
-    }
-    else if (srcFormat == pfRGB48)
-    {
-        d->inputDataType = TYPE_BGR_16;
-        d->outputDataType = d->inputDataType;
-        d->inputP2PType = p2p_rgb48;
-        d->outputP2PType = d->inputP2PType;
-    }
-    else if (srcFormat == pfRGBS)
-    {
-        d->inputDataType = TYPE_RGB_FLT | PLANAR_SH(1);
-        d->outputDataType = d->inputDataType;
-#ifdef USE_LCMS2_FAST_FLOAT
-        cmsPlugin(cmsFastFloatExtensions());
-#endif
-    }
-    else
-        return filterError("iccc: Currently only RGB24 and RGB48 input formats are well supported.");
-
-    int err;
+    if (!setDataTypes(d.get(), vi.format) || d->inputSpace != cmsSigRgbData)
+        return filterError("iccc: Currently only 8 to 16 bit integer RGB, RGBS, RGBH and YUV 4:4:4, 4:2:2 or 4:2:0 input formats are well supported.");
+    bool isFloat = vi.format.sampleType == stFloat;
 
-    bool inverse = !!vsapi->mapGetInt(in, "inverse", 0, &err);
-    if (err)
-        inverse = false;
+    bool inverse = args.inverse;
 
-    const char *dstProfile = vsapi->mapGetData(in, "display_icc", 0, &err);
-    if (err || !dstProfile)
+    const char *dstProfile = args.displayIcc;
+    if (!dstProfile)
     {
         d->outputProfile = getSystemProfile();
         if (!d->outputProfile)
@@ -625,20 +2115,17 @@ void VS_CC iccpCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
             return filterError("iccc: Display profile must have 'display' ('mntr') or 'output' ('prtr') device class.");
     }
 
-    double gamma = vsapi->mapGetFloat(in, "gamma", 0, &err);
-    if (err)
-        gamma = -1.0;
-    else if ((gamma < 0.01) || (gamma > 100.0))
+    // A negative gamma is the default of the display's own curve
+    double gamma = args.gamma;
+    if (gamma >= 0.0 && ((gamma < 0.01) || (gamma > 100.0)))
         return filterError("iccc: Input gamma value is only allowed between 0.01 and 100.0.");
 
-    double contrast = vsapi->mapGetFloat(in, "contrast", 0, &err);
-    if (err)
-        contrast = 0.0;
-    else if (contrast < 0.0)
+    double contrast = args.contrast;
+    if (contrast < 0.0)
         return filterError("iccc: Input contrast value must be positive.");
 
-    const char *srcProfilePath = vsapi->mapGetData(in, "csp", 0, &err);
-    if (err || strcmp(srcProfilePath, "709") == 0)
+    const char *srcProfilePath = args.csp;
+    if (!srcProfilePath || strcmp(srcProfilePath, "709") == 0)
     {
         inputProfile = getPlaybackProfile(csp_709, gamma, contrast, d->outputProfile);
         if (inverse)
@@ -650,6 +2137,7 @@ void VS_CC iccpCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
     else if ((strcmp(srcProfilePath, "170m") == 0) || (strcmp(srcProfilePath, "170M") == 0) || (strcmp(srcProfilePath, "601-525") == 0))
     {
         inputProfile = getPlaybackProfile(csp_601_525, gamma, contrast, d->outputProfile);
+        d->matrix = VSC_MATRIX_ST170_M;
         if (inverse)
         {
             d->primaries = VSC_PRIMARIES_ST170_M;
@@ -659,6 +2147,7 @@ void VS_CC iccpCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
     else if (strcmp(srcProfilePath, "2020") == 0)
     {
         inputProfile = getPlaybackProfile(csp_2020, gamma, contrast, d->outputProfile);
+        d->matrix = VSC_MATRIX_BT2020_NCL;
         if (inverse)
         {
             d->primaries = VSC_PRIMARIES_BT2020;
@@ -670,8 +2159,8 @@ void VS_CC iccpCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
     if (!inputProfile)
         return filterError("iccc: Failed to generate ICC profile for playback.");
 
-    const char *intentString = vsapi->mapGetData(in, "intent", 0, &err);
-    if (err) // Default of mpv
+    const char *intentString = args.intent;
+    if (!intentString) // Default of mpv
         d->intent = INTENT_RELATIVE_COLORIMETRIC;
     else
     {
@@ -681,65 +2170,181 @@ void VS_CC iccpCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core,
         d->intent = itt;
     }
 
-    d->transformFlag = srcFormat == pfRGBS ? 0 : cmsFLAGS_NONEGATIVES;
+    d->transformFlag = isFloat ? 0 : cmsFLAGS_NONEGATIVES;
 
-    bool blackPointCompensation = vsapi->mapGetInt(in, "black_point_compensation", 0, &err);
-    if (err)
-        blackPointCompensation = true;
-    if (blackPointCompensation)
+    if (args.blackPointCompensation)
         d->transformFlag |= cmsFLAGS_BLACKPOINTCOMPENSATION;
 
-    int clutSize = vsh::int64ToIntS(vsapi->mapGetInt(in, "clut_size", 0, &err));
-    if (err) clutSize = 1;
-    if (clutSize == -1) clutSize = 17; // default for cmsFLAGS_LOWRESPRECALC
-    else if (clutSize == 0) clutSize = 33; // default
-    else if (clutSize == 1) clutSize = 49; // default for cmsFLAGS_HIGHRESPRECALC
-    else if ((clutSize < -1) || (clutSize > 255))
+    int clutSize = getClutSize(args.clutSize);
+    if (!clutSize)
         return filterError("iccc: Input clut size seems invalid.");
     d->transformFlag |= cmsFLAGS_GRIDPOINTS(clutSize);
+    d->clutSize = clutSize;
+
+    if (!createWorkers(args.threads, coreThreads, d.get()))
+        return filterError("iccc: Input threads must not be negative.");
+
+    if (!getEngine(args.engine, d.get()))
+        return filterError("iccc: Input engine must be one of 'auto', 'lcms' and 'lut'.");
+    if (d->engine == engineType::lut && isFloat)
+        return filterError("iccc: The 'lut' engine only supports integer RGB.");
+    if (!getDiskCache(args.diskCache, d.get()))
+        return filterError("iccc: Unable to locate a directory for disk_cache.");
+
+    if (!getLayout(args.layout, d.get()))
+        return filterError("iccc: Input layout must be one of 'auto', 'packed', 'planar' and 'padded'.");
+    if (!getDither(args.dither, d.get()))
+        return filterError("iccc: Input dither must be one of 'none', 'ordered', 'blue_noise' and 'error_diffusion'.");
+    if (!setOutputFormat(d.get(), args.format))
+        return filterError("iccc: Output format must be integer RGB, or gray for gray output, of 8 bits up to the output depth, or YUV 4:4:4, 4:2:2 or 4:2:0 of the same sample type as the input, 8 to 16 bit integer or 32 bit float.");
+    if (vi.width % (1 << d->vi.format.subSamplingW) || vi.height % (1 << d->vi.format.subSamplingH))
+        return filterError("iccc: Frame dimensions must be multiples of the output chroma subsampling.");
+    d->passthrough = canPassThrough(d->inputFormat, d->vi.format);
+
+    cmsUInt32Number inputID[4];
+    getProfileID(inputProfile, inputID);
+    getProfileID(d->outputProfile, d->outputID);
 
     if (inverse)
     {
-        d->defaultTransform = cmsCreateTransform(d->outputProfile, d->inputDataType, inputProfile, d->outputDataType, d->intent, d->transformFlag);
-
-        cmsUInt32Number outputProfileSize = 0;
-        cmsSaveProfileToMem(inputProfile, nullptr, &outputProfileSize);
-        if (outputProfileSize > 0)
-        {
-            d->outputProfileData.resize(outputProfileSize);
-            if(!cmsSaveProfileToMem(inputProfile, d->outputProfileData.data(), &outputProfileSize))
-                d->outputProfileData.clear();
-        }
-        if (outputProfileSize <= 0 || d->outputProfileData.size() == 0)
-            vsapi->logMessage(mtWarning, "iccc: Won't set ICC frame props.", core);
+        d->defaultTransform = createDefaultTransform(d.get(), d->outputProfile, d->outputID, inputProfile, inputID);
+        saveOutputProfile(d.get(), inputProfile, warnings);
     }
     else
     {
-        d->defaultTransform = cmsCreateTransform(inputProfile, d->inputDataType, d->outputProfile, d->outputDataType, d->intent, d->transformFlag);
-        cmsUInt32Number outputProfileSize = 0;
-        cmsSaveProfileToMem(d->outputProfile, nullptr, &outputProfileSize);
-        if (outputProfileSize > 0)
-        {
-            d->outputProfileData.resize(outputProfileSize);
-            if(!cmsSaveProfileToMem(d->outputProfile, d->outputProfileData.data(), &outputProfileSize))
-                d->outputProfileData.clear();
-        }
-        if (outputProfileSize <= 0 || d->outputProfileData.size() == 0)
-            vsapi->logMessage(mtWarning, "iccc: Won't set ICC frame props.", core);
+        d->defaultTransform = createDefaultTransform(d.get(), inputProfile, inputID, d->outputProfile, d->outputID);
+        saveOutputProfile(d.get(), d->outputProfile, warnings);
     }
     if (!d->defaultTransform)
         return filterError("iccc: Failed to create transform for playback.");
     // This is not necessary but we are going to free defaultTransform there
     inputICCData ind(inputProfile, d->intent);
-    d->transformMap[ind] = d->defaultTransform;
+    d->transforms.insert(ind, d->defaultTransform);
     cmsCloseProfile(inputProfile);
 
     d->preferProps = false;
 
-    std::vector<VSFilterDependency> depReq = { {d->node, rpStrictSpatial} };
+    d->stats->filter = "Playback";
+    registerStats(d->stats);
+    return d.release();
+}
 
-    vsapi->createVideoFilter(out, "Playback", &d->vi, icccGetFrame, icccFree, fmParallel, depReq.data(), depReq.size(), d.get(), core);
-    d.release();
+// Creates the VapourSynth filter around a conversion, or sets the error
+static void createFilter(const char *name, VSNode *node, icccData *d, const std::string &error, const std::vector<std::string> &warnings, const VSMap *in, VSMap *out, VSCore *core, const VSAPI *vsapi)
+{
+    for (auto &warning : warnings)
+        vsapi->logMessage(mtWarning, warning.c_str(), core);
+    if (!d)
+    {
+        vsapi->freeNode(node);
+        vsapi->mapSetError(out, error.c_str());
+        return;
+    }
+
+    int err;
+    icccFilter *f = new icccFilter();
+    f->node = node;
+    f->data = d;
+    f->statsProps = !!vsapi->mapGetInt(in, "stats", 0, &err);
+
+    // Prefetching looks at the props of the following frames
+    std::vector<VSFilterDependency> depReq = { {node, d->prefetch > 0 ? rpGeneral : rpStrictSpatial} };
+
+    vsapi->createVideoFilter(out, name, &d->vi, icccGetFrame, icccFree, fmParallel, depReq.data(), depReq.size(), f, core);
+}
+
+static int getCoreThreads(VSCore *core, const VSAPI *vsapi)
+{
+    VSCoreInfo info;
+    vsapi->getCoreInfo(core, &info);
+    return info.numThreads;
+}
+
+// Looks up the format option, left undefined if not given. Returns false for unknown IDs.
+static bool getOutputFormat(const VSMap *in, VSVideoFormat &format, VSCore *core, const VSAPI *vsapi)
+{
+    int err;
+    int64_t id = vsapi->mapGetInt(in, "format", 0, &err);
+    if (err)
+        return true;
+    return vsapi->getVideoFormatByID(&format, static_cast<uint32_t>(id), core) && format.colorFamily != cfUndefined;
+}
+
+void VS_CC icccCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    VSNode *node = vsapi->mapGetNode(in, "clip", 0, nullptr);
+
+    int err;
+    convertArgs args;
+    args.inputIcc = vsapi->mapGetData(in, "input_icc", 0, &err);
+    args.displayIcc = vsapi->mapGetData(in, "display_icc", 0, &err);
+    args.intent = vsapi->mapGetData(in, "intent", 0, &err);
+    args.proofingIcc = vsapi->mapGetData(in, "proofing_icc", 0, &err);
+    args.proofingIntent = vsapi->mapGetData(in, "proofing_intent", 0, &err);
+    args.gamutWarning = !!vsapi->mapGetInt(in, "gamut_warning", 0, &err);
+    for (int i = 0; i < vsapi->mapNumElements(in, "gamut_warning_color"); ++i)
+        args.gamutWarningColor.push_back(vsapi->mapGetInt(in, "gamut_warning_color", i, nullptr));
+    args.blackPointCompensation = !!vsapi->mapGetInt(in, "black_point_compensation", 0, &err);
+    args.clutSize = vsh::int64ToIntS(vsapi->mapGetInt(in, "clut_size", 0, &err));
+    if (err) args.clutSize = 1;
+    args.preferProps = vsapi->mapGetInt(in, "prefer_props", 0, &err) || err;
+    args.threads = vsh::int64ToIntS(vsapi->mapGetInt(in, "threads", 0, &err));
+    if (err) args.threads = 1;
+    args.engine = vsapi->mapGetData(in, "engine", 0, &err);
+    args.cacheMB = vsapi->mapGetInt(in, "cache_mb", 0, &err);
+    if (err) args.cacheMB = 512;
+    args.prefetch = vsapi->mapGetInt(in, "prefetch", 0, &err);
+    for (int i = 0; i < vsapi->mapNumElements(in, "warmup"); ++i)
+        args.warmup.push_back(vsapi->mapGetData(in, "warmup", i, nullptr));
+    args.diskCache = !!vsapi->mapGetInt(in, "disk_cache", 0, &err);
+    if (!getOutputFormat(in, args.format, core, vsapi))
+    {
+        vsapi->freeNode(node);
+        vsapi->mapSetError(out, "iccc: Output format seems invalid.");
+        return;
+    }
+    args.dither = vsapi->mapGetData(in, "dither", 0, &err);
+
+    std::string error;
+    std::vector<std::string> warnings;
+    icccData *d = createConvert(*vsapi->getVideoInfo(node), args, getCoreThreads(core, vsapi), error, warnings);
+    createFilter("Convert", node, d, error, warnings, in, out, core, vsapi);
+}
+
+void VS_CC iccpCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    VSNode *node = vsapi->mapGetNode(in, "clip", 0, nullptr);
+
+    int err;
+    playbackArgs args;
+    args.csp = vsapi->mapGetData(in, "csp", 0, &err);
+    args.displayIcc = vsapi->mapGetData(in, "display_icc", 0, &err);
+    args.gamma = vsapi->mapGetFloat(in, "gamma", 0, &err);
+    if (err) args.gamma = -1.0;
+    // Negative values are only the default when not given
+    else if (args.gamma < 0.0) args.gamma = 0.0;
+    args.contrast = vsapi->mapGetFloat(in, "contrast", 0, &err);
+    args.intent = vsapi->mapGetData(in, "intent", 0, &err);
+    args.blackPointCompensation = vsapi->mapGetInt(in, "black_point_compensation", 0, &err) || err;
+    args.clutSize = vsh::int64ToIntS(vsapi->mapGetInt(in, "clut_size", 0, &err));
+    if (err) args.clutSize = 1;
+    args.inverse = !!vsapi->mapGetInt(in, "inverse", 0, &err);
+    args.threads = vsh::int64ToIntS(vsapi->mapGetInt(in, "threads", 0, &err));
+    if (err) args.threads = 1;
+    args.engine = vsapi->mapGetData(in, "engine", 0, &err);
+    args.diskCache = !!vsapi->mapGetInt(in, "disk_cache", 0, &err);
+    if (!getOutputFormat(in, args.format, core, vsapi))
+    {
+        vsapi->freeNode(node);
+        vsapi->mapSetError(out, "iccc: Output format seems invalid.");
+        return;
+    }
+    args.dither = vsapi->mapGetData(in, "dither", 0, &err);
+
+    std::string error;
+    std::vector<std::string> warnings;
+    icccData *d = createPlayback(*vsapi->getVideoInfo(node), args, getCoreThreads(core, vsapi), error, warnings);
+    createFilter("Playback", node, d, error, warnings, in, out, core, vsapi);
 }
 
 struct tagData
@@ -0,0 +1,91 @@
+#ifndef _ICCC_ICCC
+#define _ICCC_ICCC
+
+#include "common.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// The conversion behind Convert and Playback, usable without a VapourSynth core
+struct icccData;
+struct icccStats;
+
+// Options of Convert as documented, profiles and intents are null when not given
+struct convertArgs
+{
+    const char *inputIcc = nullptr;
+    const char *displayIcc = nullptr;
+    const char *intent = nullptr;
+    const char *proofingIcc = nullptr;
+    const char *proofingIntent = nullptr;
+    bool gamutWarning = false;
+    std::vector<int64_t> gamutWarningColor;
+    bool blackPointCompensation = false;
+    int clutSize = 1;
+    bool preferProps = true;
+    int threads = 1;
+    const char *engine = nullptr;
+    int64_t cacheMB = 512;
+    int64_t prefetch = 0;
+    std::vector<const char *> warmup;
+    bool diskCache = false;
+    // YUV or lower depth output format, undefined for the transform's own
+    VSVideoFormat format = {};
+    const char *dither = nullptr;
+    // Interleave layout of lcms, "auto" if null. Not a filter option, the benchmark forces it to compare them.
+    const char *layout = nullptr;
+};
+
+// Options of Playback as documented, a negative gamma follows the display profile
+struct playbackArgs
+{
+    const char *csp = nullptr;
+    const char *displayIcc = nullptr;
+    double gamma = -1.0;
+    double contrast = 0.0;
+    const char *intent = nullptr;
+    bool blackPointCompensation = true;
+    int clutSize = 1;
+    bool inverse = false;
+    int threads = 1;
+    const char *engine = nullptr;
+    bool diskCache = false;
+    VSVideoFormat format = {};
+    const char *dither = nullptr;
+    const char *layout = nullptr;
+};
+
+// Planes of one source frame and its converted copy
+struct framePlanes
+{
+    const uint8_t *src[3];
+    ptrdiff_t srcStride;
+    uint8_t *dst[3];
+    ptrdiff_t dstStride;
+    int width;
+    int height;
+    // YUV input only: stride of the chroma planes, and _Matrix and _ColorRange of the frame, -1 if missing
+    ptrdiff_t srcChromaStride = 0;
+    int matrix = -1;
+    int range = -1;
+    // YUV output only: stride of the chroma planes
+    ptrdiff_t dstChromaStride = 0;
+};
+
+// Return null and set the error on invalid input, warnings are meant for the log.
+// Row band workers are never more than coreThreads.
+icccData *createConvert(const VSVideoInfo &vi, const convertArgs &args, int coreThreads, std::string &error, std::vector<std::string> &warnings);
+icccData *createPlayback(const VSVideoInfo &vi, const playbackArgs &args, int coreThreads, std::string &error, std::vector<std::string> &warnings);
+void freeConvert(icccData *d);
+
+const VSVideoInfo &getOutputInfo(const icccData *d);
+const icccStats &getStats(const icccData *d);
+// Interleave layout of lcms transforms: "packed", "planar" (also for float and the engines) or "padded"
+const char *getLayoutName(const icccData *d);
+
+// Reads the raw bytes of a profile file, or serializes a preset of that name. Returns false if neither works.
+bool readProfile(const char *name, std::vector<char> &blob);
+
+// Converts one frame, with the given embedded profile if props are preferred. Returns false and sets the error on failure.
+bool convertFrame(icccData *d, const framePlanes &frame, const char *iccData, size_t iccSize, std::string &error);
+
+#endif
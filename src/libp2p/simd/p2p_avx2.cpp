@@ -0,0 +1,236 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <cstdint>
+#include <immintrin.h>
+#include "../p2p.h"
+#include "p2p_simd.h"
+#include "shuffle_rgb.h"
+
+namespace P2P_NAMESPACE {
+namespace simd {
+
+namespace {
+
+typedef void (*unpack_func)(const void *, void * const *, unsigned, unsigned);
+typedef void (*pack_func)(const void * const *, void *, unsigned, unsigned);
+
+// Transposes the 4x4 dwords within each 128-bit lane.
+void transpose4_epi32(__m256i &x0, __m256i &x1, __m256i &x2, __m256i &x3)
+{
+	__m256i t0 = _mm256_unpacklo_epi32(x0, x1);
+	__m256i t1 = _mm256_unpacklo_epi32(x2, x3);
+	__m256i t2 = _mm256_unpackhi_epi32(x0, x1);
+	__m256i t3 = _mm256_unpackhi_epi32(x2, x3);
+
+	x0 = _mm256_unpacklo_epi64(t0, t1);
+	x1 = _mm256_unpackhi_epi64(t0, t1);
+	x2 = _mm256_unpacklo_epi64(t2, t3);
+	x3 = _mm256_unpackhi_epi64(t2, t3);
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, unpack_func Rest>
+void unpack_rgb32_avx2(const void *src, void * const * dst, unsigned left, unsigned right)
+{
+	const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0));
+	// After the transpose, lane 0 holds pixels 0-3, 8-11, 16-19, 24-27 and lane 1 the others.
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	const uint32_t *src_p = static_cast<const uint32_t *>(src);
+	uint8_t *dst_r = static_cast<uint8_t *>(dst[0]);
+	uint8_t *dst_g = static_cast<uint8_t *>(dst[1]);
+	uint8_t *dst_b = static_cast<uint8_t *>(dst[2]);
+	uint8_t *dst_a = static_cast<uint8_t *>(dst[3]);
+
+	if (!dst_a)
+		dst_a = dst_r; // Write alpha to some other channel if disabled.
+
+	size_t vec_right = left + (right - left) / 32 * 32;
+
+	// Must always write alpha component first!
+	for (size_t i = left; i < vec_right; i += 32) {
+		__m256i x0 = _mm256_loadu_si256((const __m256i *)(src_p + i + 0));
+		__m256i x1 = _mm256_loadu_si256((const __m256i *)(src_p + i + 8));
+		__m256i x2 = _mm256_loadu_si256((const __m256i *)(src_p + i + 16));
+		__m256i x3 = _mm256_loadu_si256((const __m256i *)(src_p + i + 24));
+
+		x0 = _mm256_shuffle_epi8(x0, shuffle);
+		x1 = _mm256_shuffle_epi8(x1, shuffle);
+		x2 = _mm256_shuffle_epi8(x2, shuffle);
+		x3 = _mm256_shuffle_epi8(x3, shuffle);
+		transpose4_epi32(x0, x1, x2, x3);
+
+		__m256i regs[4] = {
+			_mm256_permutevar8x32_epi32(x0, order), _mm256_permutevar8x32_epi32(x1, order),
+			_mm256_permutevar8x32_epi32(x2, order), _mm256_permutevar8x32_epi32(x3, order),
+		};
+		_mm256_storeu_si256((__m256i *)(dst_a + i), regs[IdxA]);
+		_mm256_storeu_si256((__m256i *)(dst_r + i), regs[IdxR]);
+		_mm256_storeu_si256((__m256i *)(dst_g + i), regs[IdxG]);
+		_mm256_storeu_si256((__m256i *)(dst_b + i), regs[IdxB]);
+	}
+	Rest(src, dst, static_cast<unsigned>(vec_right), right);
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool AlphaOneFill, pack_func Rest>
+void pack_rgb32_avx2(const void * const *src, void *dst, unsigned left, unsigned right)
+{
+	const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0));
+	// Inverse of the order in unpack_rgb32_avx2.
+	const __m256i order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	const __m256i alpha_fill = _mm256_set1_epi8(AlphaOneFill ? static_cast<char>(0xFF) : 0);
+
+	const uint8_t *src_r = static_cast<const uint8_t *>(src[0]);
+	const uint8_t *src_g = static_cast<const uint8_t *>(src[1]);
+	const uint8_t *src_b = static_cast<const uint8_t *>(src[2]);
+	const uint8_t *src_a = static_cast<const uint8_t *>(src[3]);
+	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+
+	size_t vec_right = left + (right - left) / 32 * 32;
+
+	for (size_t i = left; i < vec_right; i += 32) {
+		__m256i regs[4];
+		regs[IdxR] = _mm256_loadu_si256((const __m256i *)(src_r + i));
+		regs[IdxG] = _mm256_loadu_si256((const __m256i *)(src_g + i));
+		regs[IdxB] = _mm256_loadu_si256((const __m256i *)(src_b + i));
+		regs[IdxA] = src_a ? _mm256_loadu_si256((const __m256i *)(src_a + i)) : alpha_fill;
+
+		__m256i x0 = _mm256_permutevar8x32_epi32(regs[0], order);
+		__m256i x1 = _mm256_permutevar8x32_epi32(regs[1], order);
+		__m256i x2 = _mm256_permutevar8x32_epi32(regs[2], order);
+		__m256i x3 = _mm256_permutevar8x32_epi32(regs[3], order);
+		transpose4_epi32(x0, x1, x2, x3);
+
+		_mm256_storeu_si256((__m256i *)(dst_p + i + 0), _mm256_shuffle_epi8(x0, shuffle));
+		_mm256_storeu_si256((__m256i *)(dst_p + i + 8), _mm256_shuffle_epi8(x1, shuffle));
+		_mm256_storeu_si256((__m256i *)(dst_p + i + 16), _mm256_shuffle_epi8(x2, shuffle));
+		_mm256_storeu_si256((__m256i *)(dst_p + i + 24), _mm256_shuffle_epi8(x3, shuffle));
+	}
+	Rest(src, dst, static_cast<unsigned>(vec_right), right);
+}
+
+// The shuffles stay within 128-bit lanes, so each lane handles its own 48 bytes of packed pixels
+// and the planes of both lanes are contiguous.
+__m256i loadu2(const uint8_t *lo, const uint8_t *hi)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)lo)), _mm_loadu_si128((const __m128i *)hi), 1);
+}
+
+void storeu2(uint8_t *lo, uint8_t *hi, __m256i x)
+{
+	_mm_storeu_si128((__m128i *)lo, _mm256_castsi256_si128(x));
+	_mm_storeu_si128((__m128i *)hi, _mm256_extracti128_si256(x, 1));
+}
+
+template <class Shuffle, unpack_func Rest>
+void unpack_rgb_avx2(const void *src, void * const *dst, unsigned left, unsigned right)
+{
+	static constexpr Shuffle shuffle{};
+	const size_t step = Shuffle::vec_pixels * 2;
+
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t * const dst_p[3] = { static_cast<uint8_t *>(dst[0]), static_cast<uint8_t *>(dst[1]), static_cast<uint8_t *>(dst[2]) };
+
+	__m256i masks[3][3];
+	for (unsigned p = 0; p < 3; ++p) {
+		for (unsigned v = 0; v < 3; ++v)
+			masks[p][v] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)shuffle.unpack[p][v]));
+	}
+
+	size_t vec_right = left + (right - left) / step * step;
+
+	for (size_t i = left; i < vec_right; i += step) {
+		const uint8_t *s = src_p + i * Shuffle::pixel_size;
+		__m256i x0 = loadu2(s + 0, s + 48);
+		__m256i x1 = loadu2(s + 16, s + 64);
+		__m256i x2 = loadu2(s + 32, s + 80);
+
+		for (unsigned p = 0; p < 3; ++p) {
+			__m256i y = _mm256_or_si256(_mm256_shuffle_epi8(x0, masks[p][0]), _mm256_shuffle_epi8(x1, masks[p][1]));
+			y = _mm256_or_si256(y, _mm256_shuffle_epi8(x2, masks[p][2]));
+			_mm256_storeu_si256((__m256i *)(dst_p[p] + i * Shuffle::bytes), y);
+		}
+	}
+	Rest(src, dst, static_cast<unsigned>(vec_right), right);
+}
+
+template <class Shuffle, pack_func Rest>
+void pack_rgb_avx2(const void * const *src, void *dst, unsigned left, unsigned right)
+{
+	static constexpr Shuffle shuffle{};
+	const size_t step = Shuffle::vec_pixels * 2;
+
+	const uint8_t * const src_p[3] = { static_cast<const uint8_t *>(src[0]), static_cast<const uint8_t *>(src[1]), static_cast<const uint8_t *>(src[2]) };
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+
+	__m256i masks[3][3];
+	for (unsigned v = 0; v < 3; ++v) {
+		for (unsigned p = 0; p < 3; ++p)
+			masks[v][p] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)shuffle.pack[v][p]));
+	}
+
+	size_t vec_right = left + (right - left) / step * step;
+
+	for (size_t i = left; i < vec_right; i += step) {
+		__m256i r = _mm256_loadu_si256((const __m256i *)(src_p[0] + i * Shuffle::bytes));
+		__m256i g = _mm256_loadu_si256((const __m256i *)(src_p[1] + i * Shuffle::bytes));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src_p[2] + i * Shuffle::bytes));
+		uint8_t *d = dst_p + i * Shuffle::pixel_size;
+
+		for (unsigned v = 0; v < 3; ++v) {
+			__m256i y = _mm256_or_si256(_mm256_shuffle_epi8(r, masks[v][0]), _mm256_shuffle_epi8(g, masks[v][1]));
+			y = _mm256_or_si256(y, _mm256_shuffle_epi8(b, masks[v][2]));
+			storeu2(d + v * 16, d + 48 + v * 16, y);
+		}
+	}
+	Rest(src, dst, static_cast<unsigned>(vec_right), right);
+}
+
+} // namespace
+
+
+// The pixels left over by the wide loops go to the SSE4.1 kernels
+#define RGB32_AVX2(format, a, b, c, d) \
+  void unpack_##format##_avx2(const void *src, void * const * dst, unsigned left, unsigned right) \
+  { \
+    unpack_rgb32_avx2<a, b, c, d, unpack_##format##_sse41>(src, dst, left, right); \
+  } \
+  void pack_##format##_0_avx2(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_avx2<a, b, c, d, 0, pack_##format##_0_sse41>(src, dst, left, right); \
+  } \
+  void pack_##format##_1_avx2(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_avx2<a, b, c, d, 1, pack_##format##_1_sse41>(src, dst, left, right); \
+  }
+
+RGB32_AVX2(argb32_be, 1, 2, 3, 0)
+RGB32_AVX2(argb32_le, 2, 1, 0, 3)
+RGB32_AVX2(rgba32_be, 0, 1, 2, 3)
+RGB32_AVX2(rgba32_le, 3, 2, 1, 0)
+
+// Without alpha, both pack variants are the same
+#define RGB_AVX2(format, bytes, r, g, b, be) \
+  void unpack_##format##_avx2(const void *src, void * const * dst, unsigned left, unsigned right) \
+  { \
+    unpack_rgb_avx2<shuffle_rgb<bytes, r, g, b, be>, unpack_##format##_sse41>(src, dst, left, right); \
+  } \
+  void pack_##format##_0_avx2(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb_avx2<shuffle_rgb<bytes, r, g, b, be>, pack_##format##_0_sse41>(src, dst, left, right); \
+  } \
+  void pack_##format##_1_avx2(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb_avx2<shuffle_rgb<bytes, r, g, b, be>, pack_##format##_1_sse41>(src, dst, left, right); \
+  }
+
+RGB_AVX2(rgb24_be, 1, 0, 1, 2, false)
+RGB_AVX2(rgb24_le, 1, 2, 1, 0, false)
+RGB_AVX2(rgb48_be, 2, 0, 1, 2, true)
+RGB_AVX2(rgb48_le, 2, 2, 1, 0, false)
+
+} // namespace simd
+} // namespace p2p
+
+#endif // x86
+#endif // P2P_SIMD
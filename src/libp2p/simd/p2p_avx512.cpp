@@ -0,0 +1,246 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <cstdint>
+#include <immintrin.h>
+#include "../p2p.h"
+#include "p2p_simd.h"
+#include "shuffle_rgb.h"
+
+namespace P2P_NAMESPACE {
+namespace simd {
+
+namespace {
+
+typedef void (*unpack_func)(const void *, void * const *, unsigned, unsigned);
+typedef void (*pack_func)(const void * const *, void *, unsigned, unsigned);
+
+// Transposes the 4x4 dwords within each 128-bit lane.
+void transpose4_epi32(__m512i &x0, __m512i &x1, __m512i &x2, __m512i &x3)
+{
+	__m512i t0 = _mm512_unpacklo_epi32(x0, x1);
+	__m512i t1 = _mm512_unpacklo_epi32(x2, x3);
+	__m512i t2 = _mm512_unpackhi_epi32(x0, x1);
+	__m512i t3 = _mm512_unpackhi_epi32(x2, x3);
+
+	x0 = _mm512_unpacklo_epi64(t0, t1);
+	x1 = _mm512_unpackhi_epi64(t0, t1);
+	x2 = _mm512_unpacklo_epi64(t2, t3);
+	x3 = _mm512_unpackhi_epi64(t2, t3);
+}
+
+__m512i broadcast_shuffle(const uint8_t *mask)
+{
+	return _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)mask));
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, unpack_func Rest>
+void unpack_rgb32_avx512(const void *src, void * const * dst, unsigned left, unsigned right)
+{
+	const __m512i shuffle = _mm512_broadcast_i32x4(_mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0));
+	// After the transpose, dword 4 * L + d holds the 4 pixels from 16 * d + 4 * L.
+	const __m512i order = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+	const uint32_t *src_p = static_cast<const uint32_t *>(src);
+	uint8_t *dst_r = static_cast<uint8_t *>(dst[0]);
+	uint8_t *dst_g = static_cast<uint8_t *>(dst[1]);
+	uint8_t *dst_b = static_cast<uint8_t *>(dst[2]);
+	uint8_t *dst_a = static_cast<uint8_t *>(dst[3]);
+
+	if (!dst_a)
+		dst_a = dst_r; // Write alpha to some other channel if disabled.
+
+	size_t vec_right = left + (right - left) / 64 * 64;
+
+	// Must always write alpha component first!
+	for (size_t i = left; i < vec_right; i += 64) {
+		__m512i x0 = _mm512_loadu_si512(src_p + i + 0);
+		__m512i x1 = _mm512_loadu_si512(src_p + i + 16);
+		__m512i x2 = _mm512_loadu_si512(src_p + i + 32);
+		__m512i x3 = _mm512_loadu_si512(src_p + i + 48);
+
+		x0 = _mm512_shuffle_epi8(x0, shuffle);
+		x1 = _mm512_shuffle_epi8(x1, shuffle);
+		x2 = _mm512_shuffle_epi8(x2, shuffle);
+		x3 = _mm512_shuffle_epi8(x3, shuffle);
+		transpose4_epi32(x0, x1, x2, x3);
+
+		__m512i regs[4] = {
+			_mm512_permutexvar_epi32(order, x0), _mm512_permutexvar_epi32(order, x1),
+			_mm512_permutexvar_epi32(order, x2), _mm512_permutexvar_epi32(order, x3),
+		};
+		_mm512_storeu_si512(dst_a + i, regs[IdxA]);
+		_mm512_storeu_si512(dst_r + i, regs[IdxR]);
+		_mm512_storeu_si512(dst_g + i, regs[IdxG]);
+		_mm512_storeu_si512(dst_b + i, regs[IdxB]);
+	}
+	Rest(src, dst, static_cast<unsigned>(vec_right), right);
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool AlphaOneFill, pack_func Rest>
+void pack_rgb32_avx512(const void * const *src, void *dst, unsigned left, unsigned right)
+{
+	const __m512i shuffle = _mm512_broadcast_i32x4(_mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0));
+	// The order in unpack_rgb32_avx512 is its own inverse.
+	const __m512i order = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	const __m512i alpha_fill = _mm512_set1_epi8(AlphaOneFill ? static_cast<char>(0xFF) : 0);
+
+	const uint8_t *src_r = static_cast<const uint8_t *>(src[0]);
+	const uint8_t *src_g = static_cast<const uint8_t *>(src[1]);
+	const uint8_t *src_b = static_cast<const uint8_t *>(src[2]);
+	const uint8_t *src_a = static_cast<const uint8_t *>(src[3]);
+	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+
+	size_t vec_right = left + (right - left) / 64 * 64;
+
+	for (size_t i = left; i < vec_right; i += 64) {
+		__m512i regs[4];
+		regs[IdxR] = _mm512_loadu_si512(src_r + i);
+		regs[IdxG] = _mm512_loadu_si512(src_g + i);
+		regs[IdxB] = _mm512_loadu_si512(src_b + i);
+		regs[IdxA] = src_a ? _mm512_loadu_si512(src_a + i) : alpha_fill;
+
+		__m512i x0 = _mm512_permutexvar_epi32(order, regs[0]);
+		__m512i x1 = _mm512_permutexvar_epi32(order, regs[1]);
+		__m512i x2 = _mm512_permutexvar_epi32(order, regs[2]);
+		__m512i x3 = _mm512_permutexvar_epi32(order, regs[3]);
+		transpose4_epi32(x0, x1, x2, x3);
+
+		_mm512_storeu_si512(dst_p + i + 0, _mm512_shuffle_epi8(x0, shuffle));
+		_mm512_storeu_si512(dst_p + i + 16, _mm512_shuffle_epi8(x1, shuffle));
+		_mm512_storeu_si512(dst_p + i + 32, _mm512_shuffle_epi8(x2, shuffle));
+		_mm512_storeu_si512(dst_p + i + 48, _mm512_shuffle_epi8(x3, shuffle));
+	}
+	Rest(src, dst, static_cast<unsigned>(vec_right), right);
+}
+
+// The shuffles stay within 128-bit lanes, so each lane handles its own 48 bytes of packed pixels
+// and the planes of the four lanes are contiguous.
+__m512i loadu4(const uint8_t *p)
+{
+	__m512i x = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i *)p));
+	x = _mm512_inserti32x4(x, _mm_loadu_si128((const __m128i *)(p + 48)), 1);
+	x = _mm512_inserti32x4(x, _mm_loadu_si128((const __m128i *)(p + 96)), 2);
+	return _mm512_inserti32x4(x, _mm_loadu_si128((const __m128i *)(p + 144)), 3);
+}
+
+void storeu4(uint8_t *p, __m512i x)
+{
+	_mm_storeu_si128((__m128i *)p, _mm512_castsi512_si128(x));
+	_mm_storeu_si128((__m128i *)(p + 48), _mm512_extracti32x4_epi32(x, 1));
+	_mm_storeu_si128((__m128i *)(p + 96), _mm512_extracti32x4_epi32(x, 2));
+	_mm_storeu_si128((__m128i *)(p + 144), _mm512_extracti32x4_epi32(x, 3));
+}
+
+template <class Shuffle, unpack_func Rest>
+void unpack_rgb_avx512(const void *src, void * const *dst, unsigned left, unsigned right)
+{
+	static constexpr Shuffle shuffle{};
+	const size_t step = Shuffle::vec_pixels * 4;
+
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t * const dst_p[3] = { static_cast<uint8_t *>(dst[0]), static_cast<uint8_t *>(dst[1]), static_cast<uint8_t *>(dst[2]) };
+
+	__m512i masks[3][3];
+	for (unsigned p = 0; p < 3; ++p) {
+		for (unsigned v = 0; v < 3; ++v)
+			masks[p][v] = broadcast_shuffle(shuffle.unpack[p][v]);
+	}
+
+	size_t vec_right = left + (right - left) / step * step;
+
+	for (size_t i = left; i < vec_right; i += step) {
+		const uint8_t *s = src_p + i * Shuffle::pixel_size;
+		__m512i x0 = loadu4(s + 0);
+		__m512i x1 = loadu4(s + 16);
+		__m512i x2 = loadu4(s + 32);
+
+		for (unsigned p = 0; p < 3; ++p) {
+			__m512i y = _mm512_or_si512(_mm512_shuffle_epi8(x0, masks[p][0]), _mm512_shuffle_epi8(x1, masks[p][1]));
+			y = _mm512_or_si512(y, _mm512_shuffle_epi8(x2, masks[p][2]));
+			_mm512_storeu_si512(dst_p[p] + i * Shuffle::bytes, y);
+		}
+	}
+	Rest(src, dst, static_cast<unsigned>(vec_right), right);
+}
+
+template <class Shuffle, pack_func Rest>
+void pack_rgb_avx512(const void * const *src, void *dst, unsigned left, unsigned right)
+{
+	static constexpr Shuffle shuffle{};
+	const size_t step = Shuffle::vec_pixels * 4;
+
+	const uint8_t * const src_p[3] = { static_cast<const uint8_t *>(src[0]), static_cast<const uint8_t *>(src[1]), static_cast<const uint8_t *>(src[2]) };
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+
+	__m512i masks[3][3];
+	for (unsigned v = 0; v < 3; ++v) {
+		for (unsigned p = 0; p < 3; ++p)
+			masks[v][p] = broadcast_shuffle(shuffle.pack[v][p]);
+	}
+
+	size_t vec_right = left + (right - left) / step * step;
+
+	for (size_t i = left; i < vec_right; i += step) {
+		__m512i r = _mm512_loadu_si512(src_p[0] + i * Shuffle::bytes);
+		__m512i g = _mm512_loadu_si512(src_p[1] + i * Shuffle::bytes);
+		__m512i b = _mm512_loadu_si512(src_p[2] + i * Shuffle::bytes);
+		uint8_t *d = dst_p + i * Shuffle::pixel_size;
+
+		for (unsigned v = 0; v < 3; ++v) {
+			__m512i y = _mm512_or_si512(_mm512_shuffle_epi8(r, masks[v][0]), _mm512_shuffle_epi8(g, masks[v][1]));
+			y = _mm512_or_si512(y, _mm512_shuffle_epi8(b, masks[v][2]));
+			storeu4(d + v * 16, y);
+		}
+	}
+	Rest(src, dst, static_cast<unsigned>(vec_right), right);
+}
+
+} // namespace
+
+
+// The pixels left over by the wide loops go to the AVX2 kernels
+#define RGB32_AVX512(format, a, b, c, d) \
+  void unpack_##format##_avx512(const void *src, void * const * dst, unsigned left, unsigned right) \
+  { \
+    unpack_rgb32_avx512<a, b, c, d, unpack_##format##_avx2>(src, dst, left, right); \
+  } \
+  void pack_##format##_0_avx512(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_avx512<a, b, c, d, 0, pack_##format##_0_avx2>(src, dst, left, right); \
+  } \
+  void pack_##format##_1_avx512(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_avx512<a, b, c, d, 1, pack_##format##_1_avx2>(src, dst, left, right); \
+  }
+
+RGB32_AVX512(argb32_be, 1, 2, 3, 0)
+RGB32_AVX512(argb32_le, 2, 1, 0, 3)
+RGB32_AVX512(rgba32_be, 0, 1, 2, 3)
+RGB32_AVX512(rgba32_le, 3, 2, 1, 0)
+
+// Without alpha, both pack variants are the same
+#define RGB_AVX512(format, bytes, r, g, b, be) \
+  void unpack_##format##_avx512(const void *src, void * const * dst, unsigned left, unsigned right) \
+  { \
+    unpack_rgb_avx512<shuffle_rgb<bytes, r, g, b, be>, unpack_##format##_avx2>(src, dst, left, right); \
+  } \
+  void pack_##format##_0_avx512(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb_avx512<shuffle_rgb<bytes, r, g, b, be>, pack_##format##_0_avx2>(src, dst, left, right); \
+  } \
+  void pack_##format##_1_avx512(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb_avx512<shuffle_rgb<bytes, r, g, b, be>, pack_##format##_1_avx2>(src, dst, left, right); \
+  }
+
+RGB_AVX512(rgb24_be, 1, 0, 1, 2, false)
+RGB_AVX512(rgb24_le, 1, 2, 1, 0, false)
+RGB_AVX512(rgb48_be, 2, 0, 1, 2, true)
+RGB_AVX512(rgb48_le, 2, 2, 1, 0, false)
+
+} // namespace simd
+} // namespace p2p
+
+#endif // x86
+#endif // P2P_SIMD
@@ -24,12 +24,41 @@ auto populate_unpack_table()
 #if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
 	simd::X86Capabilities x86 = simd::query_x86_capabilities();
 
+	// The first entry of a format wins, so the widest kernels go first
+	if (x86.avx512f && x86.avx512bw) {
+#define ENTRY(format, cpu) table[idx++] = unpack_table_entry{ &typeid(packed_##format), simd::unpack_##format##_##cpu }
+		ENTRY(argb32_be, avx512);
+		ENTRY(argb32_le, avx512);
+		ENTRY(rgba32_be, avx512);
+		ENTRY(rgba32_le, avx512);
+		ENTRY(rgb24_be, avx512);
+		ENTRY(rgb24_le, avx512);
+		ENTRY(rgb48_be, avx512);
+		ENTRY(rgb48_le, avx512);
+#undef ENTRY
+	}
+	if (x86.avx2) {
+#define ENTRY(format, cpu) table[idx++] = unpack_table_entry{ &typeid(packed_##format), simd::unpack_##format##_##cpu }
+		ENTRY(argb32_be, avx2);
+		ENTRY(argb32_le, avx2);
+		ENTRY(rgba32_be, avx2);
+		ENTRY(rgba32_le, avx2);
+		ENTRY(rgb24_be, avx2);
+		ENTRY(rgb24_le, avx2);
+		ENTRY(rgb48_be, avx2);
+		ENTRY(rgb48_le, avx2);
+#undef ENTRY
+	}
 	if (x86.sse41) {
 #define ENTRY(format, cpu) table[idx++] = unpack_table_entry{ &typeid(packed_##format), simd::unpack_##format##_##cpu }
 		ENTRY(argb32_be, sse41);
 		ENTRY(argb32_le, sse41);
 		ENTRY(rgba32_be, sse41);
 		ENTRY(rgba32_le, sse41);
+		ENTRY(rgb24_be, sse41);
+		ENTRY(rgb24_le, sse41);
+		ENTRY(rgb48_be, sse41);
+		ENTRY(rgb48_le, sse41);
 #undef ENTRY
 	}
 #endif
@@ -45,12 +74,41 @@ auto populate_pack_table()
 #if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
 	simd::X86Capabilities x86 = simd::query_x86_capabilities();
 
+	// The first entry of a format wins, so the widest kernels go first
+	if (x86.avx512f && x86.avx512bw) {
+#define ENTRY(format, cpu) table[idx++] = pack_table_entry{ &typeid(packed_##format), simd::pack_##format##_0_##cpu, simd::pack_##format##_1_##cpu }
+		ENTRY(argb32_be, avx512);
+		ENTRY(argb32_le, avx512);
+		ENTRY(rgba32_be, avx512);
+		ENTRY(rgba32_le, avx512);
+		ENTRY(rgb24_be, avx512);
+		ENTRY(rgb24_le, avx512);
+		ENTRY(rgb48_be, avx512);
+		ENTRY(rgb48_le, avx512);
+#undef ENTRY
+	}
+	if (x86.avx2) {
+#define ENTRY(format, cpu) table[idx++] = pack_table_entry{ &typeid(packed_##format), simd::pack_##format##_0_##cpu, simd::pack_##format##_1_##cpu }
+		ENTRY(argb32_be, avx2);
+		ENTRY(argb32_le, avx2);
+		ENTRY(rgba32_be, avx2);
+		ENTRY(rgba32_le, avx2);
+		ENTRY(rgb24_be, avx2);
+		ENTRY(rgb24_le, avx2);
+		ENTRY(rgb48_be, avx2);
+		ENTRY(rgb48_le, avx2);
+#undef ENTRY
+	}
 	if (x86.sse41) {
 #define ENTRY(format, cpu) table[idx++] = pack_table_entry{ &typeid(packed_##format), simd::pack_##format##_0_##cpu, simd::pack_##format##_1_##cpu }
 		ENTRY(argb32_be, sse41);
 		ENTRY(argb32_le, sse41);
 		ENTRY(rgba32_be, sse41);
 		ENTRY(rgba32_le, sse41);
+		ENTRY(rgb24_be, sse41);
+		ENTRY(rgb24_le, sse41);
+		ENTRY(rgb48_be, sse41);
+		ENTRY(rgb48_le, sse41);
 #undef ENTRY
 	}
 #endif
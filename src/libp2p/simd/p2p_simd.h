@@ -25,6 +25,56 @@ PACK(argb32_be, sse41)
 PACK(argb32_le, sse41)
 PACK(rgba32_be, sse41)
 PACK(rgba32_le, sse41)
+
+UNPACK(rgb24_be, sse41)
+UNPACK(rgb24_le, sse41)
+UNPACK(rgb48_be, sse41)
+UNPACK(rgb48_le, sse41)
+
+PACK(rgb24_be, sse41)
+PACK(rgb24_le, sse41)
+PACK(rgb48_be, sse41)
+PACK(rgb48_le, sse41)
+
+UNPACK(argb32_be, avx2)
+UNPACK(argb32_le, avx2)
+UNPACK(rgba32_be, avx2)
+UNPACK(rgba32_le, avx2)
+
+PACK(argb32_be, avx2)
+PACK(argb32_le, avx2)
+PACK(rgba32_be, avx2)
+PACK(rgba32_le, avx2)
+
+UNPACK(rgb24_be, avx2)
+UNPACK(rgb24_le, avx2)
+UNPACK(rgb48_be, avx2)
+UNPACK(rgb48_le, avx2)
+
+PACK(rgb24_be, avx2)
+PACK(rgb24_le, avx2)
+PACK(rgb48_be, avx2)
+PACK(rgb48_le, avx2)
+
+UNPACK(argb32_be, avx512)
+UNPACK(argb32_le, avx512)
+UNPACK(rgba32_be, avx512)
+UNPACK(rgba32_le, avx512)
+
+PACK(argb32_be, avx512)
+PACK(argb32_le, avx512)
+PACK(rgba32_be, avx512)
+PACK(rgba32_le, avx512)
+
+UNPACK(rgb24_be, avx512)
+UNPACK(rgb24_le, avx512)
+UNPACK(rgb48_be, avx512)
+UNPACK(rgb48_le, avx512)
+
+PACK(rgb24_be, avx512)
+PACK(rgb24_le, avx512)
+PACK(rgb48_be, avx512)
+PACK(rgb48_le, avx512)
 #endif // x86
 
 #undef PACK
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <smmintrin.h>
 #include "../p2p.h"
+#include "shuffle_rgb.h"
 
 namespace P2P_NAMESPACE {
 namespace simd {
@@ -77,6 +78,13 @@ void unpack_rgb32_sse41(const void *src, void * const * dst, unsigned left, unsi
 		_mm_storeu_si128((__m128i *)(dst_b + i), regs[IdxB]);
 	};
 
+	// The aligned loops below would overrun a short span
+	if (right - left < 16) {
+		for (size_t i = left; i < right; ++i)
+			scalar_iter(i);
+		return;
+	}
+
 	for (size_t i = left; i < vec4_left; ++i)
 		scalar_iter(i);
 	for (size_t i = vec4_left; i < vec16_left; i += 4)
@@ -173,6 +181,13 @@ void pack_rgb32_sse41(const void * const *src, void *dst, unsigned left, unsigne
 		_mm_storeu_si128((__m128i *)(dst_p + i + 12), x3);
 	};
 
+	// The aligned loops below would overrun a short span
+	if (right - left < 16) {
+		for (size_t i = left; i < right; ++i)
+			scalar_iter(i);
+		return;
+	}
+
 	for (size_t i = left; i < vec4_left; ++i)
 		scalar_iter(i);
 	for (size_t i = vec4_left; i < vec16_left; i += 4)
@@ -185,6 +200,70 @@ void pack_rgb32_sse41(const void * const *src, void *dst, unsigned left, unsigne
 		scalar_iter(i);
 }
 
+template <class Shuffle>
+void unpack_rgb_sse41(const void *src, void * const *dst, unsigned left, unsigned right)
+{
+	static constexpr Shuffle shuffle{};
+	const size_t step = Shuffle::vec_pixels;
+
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t * const dst_p[3] = { static_cast<uint8_t *>(dst[0]), static_cast<uint8_t *>(dst[1]), static_cast<uint8_t *>(dst[2]) };
+
+	__m128i masks[3][3];
+	for (unsigned p = 0; p < 3; ++p) {
+		for (unsigned v = 0; v < 3; ++v)
+			masks[p][v] = _mm_loadu_si128((const __m128i *)shuffle.unpack[p][v]);
+	}
+
+	size_t vec_right = left + (right - left) / step * step;
+
+	for (size_t i = left; i < vec_right; i += step) {
+		const uint8_t *s = src_p + i * Shuffle::pixel_size;
+		__m128i x0 = _mm_loadu_si128((const __m128i *)(s + 0));
+		__m128i x1 = _mm_loadu_si128((const __m128i *)(s + 16));
+		__m128i x2 = _mm_loadu_si128((const __m128i *)(s + 32));
+
+		for (unsigned p = 0; p < 3; ++p) {
+			__m128i y = _mm_or_si128(_mm_shuffle_epi8(x0, masks[p][0]), _mm_shuffle_epi8(x1, masks[p][1]));
+			y = _mm_or_si128(y, _mm_shuffle_epi8(x2, masks[p][2]));
+			_mm_storeu_si128((__m128i *)(dst_p[p] + i * Shuffle::bytes), y);
+		}
+	}
+	Shuffle::unpack_scalar(src_p, dst_p, vec_right, right);
+}
+
+template <class Shuffle>
+void pack_rgb_sse41(const void * const *src, void *dst, unsigned left, unsigned right)
+{
+	static constexpr Shuffle shuffle{};
+	const size_t step = Shuffle::vec_pixels;
+
+	const uint8_t * const src_p[3] = { static_cast<const uint8_t *>(src[0]), static_cast<const uint8_t *>(src[1]), static_cast<const uint8_t *>(src[2]) };
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+
+	__m128i masks[3][3];
+	for (unsigned v = 0; v < 3; ++v) {
+		for (unsigned p = 0; p < 3; ++p)
+			masks[v][p] = _mm_loadu_si128((const __m128i *)shuffle.pack[v][p]);
+	}
+
+	size_t vec_right = left + (right - left) / step * step;
+
+	for (size_t i = left; i < vec_right; i += step) {
+		__m128i r = _mm_loadu_si128((const __m128i *)(src_p[0] + i * Shuffle::bytes));
+		__m128i g = _mm_loadu_si128((const __m128i *)(src_p[1] + i * Shuffle::bytes));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src_p[2] + i * Shuffle::bytes));
+		uint8_t *d = dst_p + i * Shuffle::pixel_size;
+
+		for (unsigned v = 0; v < 3; ++v) {
+			__m128i y = _mm_or_si128(_mm_shuffle_epi8(r, masks[v][0]), _mm_shuffle_epi8(g, masks[v][1]));
+			y = _mm_or_si128(y, _mm_shuffle_epi8(b, masks[v][2]));
+			_mm_storeu_si128((__m128i *)(d + v * 16), y);
+		}
+	}
+	Shuffle::pack_scalar(src_p, dst_p, vec_right, right);
+}
+
 } // namespace
 
 
@@ -207,6 +286,26 @@ RGB32_SSE41(argb32_le, 2, 1, 0, 3)
 RGB32_SSE41(rgba32_be, 0, 1, 2, 3)
 RGB32_SSE41(rgba32_le, 3, 2, 1, 0)
 
+// Without alpha, both pack variants are the same
+#define RGB_SSE41(format, bytes, r, g, b, be) \
+  void unpack_##format##_sse41(const void *src, void * const * dst, unsigned left, unsigned right) \
+  { \
+    unpack_rgb_sse41<shuffle_rgb<bytes, r, g, b, be>>(src, dst, left, right); \
+  } \
+  void pack_##format##_0_sse41(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb_sse41<shuffle_rgb<bytes, r, g, b, be>>(src, dst, left, right); \
+  } \
+  void pack_##format##_1_sse41(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb_sse41<shuffle_rgb<bytes, r, g, b, be>>(src, dst, left, right); \
+  }
+
+RGB_SSE41(rgb24_be, 1, 0, 1, 2, false)
+RGB_SSE41(rgb24_le, 1, 2, 1, 0, false)
+RGB_SSE41(rgb48_be, 2, 0, 1, 2, true)
+RGB_SSE41(rgb48_le, 2, 2, 1, 0, false)
+
 } // namespace simd
 } // namespace p2p
 
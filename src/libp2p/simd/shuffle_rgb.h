@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef P2P_SHUFFLE_RGB_H_
+#define P2P_SHUFFLE_RGB_H_
+
+#ifdef P2P_SIMD
+
+#include <cstddef>
+#include <cstdint>
+#include "../p2p.h"
+
+namespace P2P_NAMESPACE {
+namespace simd {
+
+// Byte shuffles between 48 bytes of packed 3-channel pixels and 16 bytes of each plane, i.e. 16
+// pixels of rgb24 or 8 pixels of rgb48. Pos gives the position of R, G and B within the pixel,
+// and BigEndian reverses the bytes of each sample.
+template <unsigned Bytes, unsigned PosR, unsigned PosG, unsigned PosB, bool BigEndian>
+struct shuffle_rgb {
+	static constexpr unsigned bytes = Bytes;
+	static constexpr unsigned pixel_size = Bytes * 3;
+	static constexpr unsigned vec_pixels = 16 / Bytes;
+
+	// unpack[p][v]: bytes of plane p taken from packed vector v, 0x80 where they come from another one.
+	uint8_t unpack[3][3][16] = {};
+	// pack[v][p]: bytes of packed vector v taken from plane p.
+	uint8_t pack[3][3][16] = {};
+
+	static constexpr unsigned offset(unsigned p, unsigned j)
+	{
+		return (j / Bytes) * pixel_size + (p == 0 ? PosR : p == 1 ? PosG : PosB) * Bytes +
+			(BigEndian ? Bytes - 1 - j % Bytes : j % Bytes);
+	}
+
+	constexpr shuffle_rgb()
+	{
+		for (unsigned p = 0; p < 3; ++p) {
+			for (unsigned v = 0; v < 3; ++v) {
+				for (unsigned j = 0; j < 16; ++j) {
+					unpack[p][v][j] = 0x80;
+					pack[v][p][j] = 0x80;
+				}
+			}
+		}
+		for (unsigned p = 0; p < 3; ++p) {
+			for (unsigned j = 0; j < 16; ++j) {
+				unsigned o = offset(p, j);
+				unpack[p][o / 16][j] = static_cast<uint8_t>(o % 16);
+				pack[o / 16][p][o % 16] = static_cast<uint8_t>(j);
+			}
+		}
+	}
+
+	// Pixels left of the vectors or past them
+	static void unpack_scalar(const uint8_t *src, uint8_t * const *dst, size_t left, size_t right)
+	{
+		for (size_t i = left; i < right; ++i) {
+			for (unsigned p = 0; p < 3; ++p) {
+				for (unsigned j = 0; j < Bytes; ++j)
+					dst[p][i * Bytes + j] = src[i * pixel_size + offset(p, j)];
+			}
+		}
+	}
+
+	static void pack_scalar(const uint8_t * const *src, uint8_t *dst, size_t left, size_t right)
+	{
+		for (size_t i = left; i < right; ++i) {
+			for (unsigned p = 0; p < 3; ++p) {
+				for (unsigned j = 0; j < Bytes; ++j)
+					dst[i * pixel_size + offset(p, j)] = src[p][i * Bytes + j];
+			}
+		}
+	}
+};
+
+} // namespace simd
+} // namespace p2p
+
+#endif // P2P_SIMD
+
+#endif // P2P_SHUFFLE_RGB_H_
@@ -0,0 +1,214 @@
+#include "lut.hpp"
+#include "simd.hpp"
+#include <algorithm>
+
+template <typename T>
+static void tetrahedral(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right)
+{
+    const T *srcR = static_cast<const T *>(src[0]);
+    const T *srcG = static_cast<const T *>(src[1]);
+    const T *srcB = static_cast<const T *>(src[2]);
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const int n = lut.size;
+    const int strideR = n * n * 4;
+    const int strideG = n * 4;
+    const int strideB = 4;
+
+    // Keep the operation order in sync with the SIMD kernels, so that results are identical on every CPU
+    for (int x = left; x < right; ++x)
+    {
+        float r = srcR[x] * lut.scale;
+        float g = srcG[x] * lut.scale;
+        float b = srcB[x] * lut.scale;
+        int ir = std::min(static_cast<int>(r), n - 2);
+        int ig = std::min(static_cast<int>(g), n - 2);
+        int ib = std::min(static_cast<int>(b), n - 2);
+        r -= ir;
+        g -= ig;
+        b -= ib;
+
+        // Walk from the lower corner along the axes in the order of decreasing fractions
+        float s0 = std::max(std::max(r, g), b);
+        float s1 = std::max(std::min(r, g), std::min(std::max(r, g), b));
+        float s2 = std::min(std::min(r, g), b);
+        int o0 = (r >= g && r >= b) ? strideR : (g >= b ? strideG : strideB);
+        int o2 = (b <= g && b <= r) ? strideB : (g <= r ? strideG : strideR);
+        int o1 = strideR + strideG + strideB - o0 - o2;
+
+        const float *c0 = lut.table + ir * strideR + ig * strideG + ib * strideB;
+        const float *c1 = c0 + o0;
+        const float *c2 = c1 + o1;
+        const float *c3 = c2 + o2;
+
+        for (int c = 0; c < 3; ++c)
+        {
+            float v = c0[c] + (c1[c] - c0[c]) * s0 + (c2[c] - c1[c]) * s1 + (c3[c] - c2[c]) * s2;
+            v = std::min(std::max(v, 0.0f), lut.peak);
+            dstp[c][x] = static_cast<T>(v + 0.5f);
+        }
+    }
+}
+
+void lutTetrahedral_c(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right)
+{
+    if (lut.bytesPerSample == 1)
+        tetrahedral<uint8_t>(lut, src, dst, left, right);
+    else
+        tetrahedral<uint16_t>(lut, src, dst, left, right);
+}
+
+lutEngine *lutEngine::create(cmsHTRANSFORM transform, int size, int bytesPerSample)
+{
+    if (size < 2 || (bytesPerSample != 1 && bytesPerSample != 2))
+        return nullptr;
+
+    size_t nodes = static_cast<size_t>(size) * size * size;
+    float *table = reinterpret_cast<float *>(vsh::vsh_aligned_malloc(nodes * 4 * sizeof(float), 64));
+    if (!table)
+        return nullptr;
+
+    lutEngine *engine = new lutEngine();
+    engine->lut.size = size;
+    engine->lut.table = table;
+    engine->lut.peak = bytesPerSample == 1 ? 255.0f : 65535.0f;
+    engine->lut.scale = (size - 1) / engine->lut.peak;
+    engine->lut.bytesPerSample = bytesPerSample;
+
+    // Sample one slab of constant R at a time
+    std::vector<cmsUInt16Number> grid(size);
+    for (int i = 0; i < size; ++i)
+        grid[i] = static_cast<cmsUInt16Number>((i * 65535 + (size - 1) / 2) / (size - 1));
+    std::vector<cmsUInt16Number> input(static_cast<size_t>(size) * size * 3);
+    std::vector<cmsFloat32Number> output(static_cast<size_t>(size) * size * 3);
+    for (int r = 0; r < size; ++r)
+    {
+        cmsUInt16Number *in = input.data();
+        for (int g = 0; g < size; ++g)
+        {
+            for (int b = 0; b < size; ++b)
+            {
+                *in++ = grid[r];
+                *in++ = grid[g];
+                *in++ = grid[b];
+            }
+        }
+        cmsDoTransform(transform, input.data(), output.data(), size * size);
+
+        float *node = table + static_cast<size_t>(r) * size * size * 4;
+        for (int i = 0; i < size * size; ++i)
+        {
+            node[i * 4 + 0] = output[i * 3 + 0] * engine->lut.peak;
+            node[i * 4 + 1] = output[i * 3 + 1] * engine->lut.peak;
+            node[i * 4 + 2] = output[i * 3 + 2] * engine->lut.peak;
+            node[i * 4 + 3] = 0.0f;
+        }
+    }
+
+    engine->selectKernel();
+    return engine;
+}
+
+// Header of a saved table, followed by the key and padding up to the table
+struct lutFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t lcmsVersion;
+    uint32_t size;
+    uint32_t bytesPerSample;
+    uint32_t keySize;
+    uint32_t reserved;
+    // Of the table, a file that was damaged on disk is sampled again
+    uint64_t checksum;
+};
+
+// Keeps the table aligned for SIMD loads in the mapped file
+constexpr size_t lutFileTableOffset = 256;
+static const char lutFileMagic[8] = {'I', 'C', 'C', 'C', 'L', 'U', 'T', '\0'};
+
+lutEngine *lutEngine::load(const std::string &path, const void *key, size_t keySize, int size, int bytesPerSample)
+{
+    if (size < 2 || (bytesPerSample != 1 && bytesPerSample != 2) || sizeof(lutFileHeader) + keySize > lutFileTableOffset)
+        return nullptr;
+
+    std::unique_ptr<mappedFile> file(mappedFile::open(path));
+    size_t tableBytes = static_cast<size_t>(size) * size * size * 4 * sizeof(float);
+    if (!file || file->size() != lutFileTableOffset + tableBytes)
+        return nullptr;
+
+    lutFileHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, lutFileMagic, sizeof(lutFileMagic)) != 0 || header.version != 2 ||
+        header.lcmsVersion != static_cast<uint32_t>(cmsGetEncodedCMMversion()) || header.size != static_cast<uint32_t>(size) ||
+        header.bytesPerSample != static_cast<uint32_t>(bytesPerSample) || header.keySize != keySize ||
+        memcmp(file->data() + sizeof(header), key, keySize) != 0 ||
+        header.checksum != hashBlob(file->data() + lutFileTableOffset, tableBytes))
+        return nullptr;
+
+    lutEngine *engine = new lutEngine();
+    engine->lut.size = size;
+    engine->lut.table = reinterpret_cast<const float *>(file->data() + lutFileTableOffset);
+    engine->lut.peak = bytesPerSample == 1 ? 255.0f : 65535.0f;
+    engine->lut.scale = (size - 1) / engine->lut.peak;
+    engine->lut.bytesPerSample = bytesPerSample;
+    engine->file = std::move(file);
+    engine->selectKernel();
+    return engine;
+}
+
+bool lutEngine::save(const std::string &dir, const std::string &name, const void *key, size_t keySize) const
+{
+    if (sizeof(lutFileHeader) + keySize > lutFileTableOffset)
+        return false;
+
+    uint8_t block[lutFileTableOffset] = {};
+    lutFileHeader header = {};
+    memcpy(header.magic, lutFileMagic, sizeof(lutFileMagic));
+    header.version = 2;
+    header.lcmsVersion = static_cast<uint32_t>(cmsGetEncodedCMMversion());
+    header.size = static_cast<uint32_t>(lut.size);
+    header.bytesPerSample = static_cast<uint32_t>(lut.bytesPerSample);
+    header.keySize = static_cast<uint32_t>(keySize);
+    header.checksum = hashBlob(reinterpret_cast<const uint8_t *>(lut.table), footprint());
+    memcpy(block, &header, sizeof(header));
+    memcpy(block + sizeof(header), key, keySize);
+    return writeCacheFile(dir, name, block, sizeof(block), lut.table, footprint());
+}
+
+void lutEngine::selectKernel()
+{
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    simdLevel level = getSimdLevel();
+    if (level == simdLevel::avx512)
+    {
+        kernel = lutTetrahedral_avx512;
+        vectorWidth = 16;
+    }
+    else if (level == simdLevel::avx2)
+    {
+        kernel = lutTetrahedral_avx2;
+        vectorWidth = 8;
+    }
+    else if (level == simdLevel::sse41)
+    {
+        kernel = lutTetrahedral_sse41;
+        vectorWidth = 4;
+    }
+#endif
+}
+
+lutEngine::~lutEngine()
+{
+    if (!file)
+        vsh::vsh_aligned_free(const_cast<float *>(lut.table));
+}
+
+void lutEngine::apply(const void * const src[3], void * const dst[3], int width) const
+{
+    int body = kernel ? width - width % vectorWidth : 0;
+    if (body > 0)
+        kernel(lut, src, dst, 0, body);
+    if (body < width)
+        lutTetrahedral_c(lut, src, dst, body, width);
+}
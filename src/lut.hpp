@@ -0,0 +1,44 @@
+#ifndef _ICCC_LUT
+#define _ICCC_LUT
+
+#include "common.hpp"
+#include "diskcache.hpp"
+#include "lut_kernels.hpp"
+#include <memory>
+
+class lutEngine : public planarEngine
+{
+public:
+    // Samples a transform from TYPE_RGB_16 to TYPE_RGB_FLT at size^3 nodes, null on failure
+    static lutEngine *create(cmsHTRANSFORM transform, int size, int bytesPerSample);
+    // Maps a table written by save(), null if there is none for the key, it was sampled by another lcms version or it is damaged
+    static lutEngine *load(const std::string &path, const void *key, size_t keySize, int size, int bytesPerSample);
+    ~lutEngine() override;
+
+    lutEngine(const lutEngine &) = delete;
+    lutEngine &operator=(const lutEngine &) = delete;
+
+    // Converts one row of planar samples in the format given on creation
+    void apply(const void * const src[3], void * const dst[3], int width) const override;
+
+    // Writes the table along with the key that identifies it
+    bool save(const std::string &dir, const std::string &name, const void *key, size_t keySize) const;
+
+    size_t footprint() const override
+    {
+        return static_cast<size_t>(lut.size) * lut.size * lut.size * 4 * sizeof(float);
+    }
+
+private:
+    lutEngine() = default;
+
+    void selectKernel();
+
+    lutTable lut;
+    // Owns the table if it was loaded, otherwise it's allocated
+    std::unique_ptr<mappedFile> file;
+    lutKernel kernel = nullptr;
+    int vectorWidth = 1;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <immintrin.h>
+#include "lut_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m256i loadSamples(const T *src);
+
+template <>
+__m256i loadSamples<uint8_t>(const uint8_t *src)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+}
+
+template <>
+__m256i loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+}
+
+void storeSamples(uint8_t *dst, __m256i v)
+{
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(w, w));
+}
+
+void storeSamples(uint16_t *dst, __m256i v)
+{
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), w);
+}
+
+// Interpolates one channel of eight pixels from the gathered vertices
+__m256 interpolate(const float *table, __m256i v0, __m256i v1, __m256i v2, __m256i v3, __m256 s0, __m256 s1, __m256 s2)
+{
+    __m256 c0 = _mm256_i32gather_ps(table, v0, 4);
+    __m256 c1 = _mm256_i32gather_ps(table, v1, 4);
+    __m256 c2 = _mm256_i32gather_ps(table, v2, 4);
+    __m256 c3 = _mm256_i32gather_ps(table, v3, 4);
+    __m256 v = _mm256_add_ps(c0, _mm256_mul_ps(_mm256_sub_ps(c1, c0), s0));
+    v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_sub_ps(c2, c1), s1));
+    return _mm256_add_ps(v, _mm256_mul_ps(_mm256_sub_ps(c3, c2), s2));
+}
+
+// Eight pixels per iteration, each vertex channel is gathered from the table
+template <typename T>
+void tetrahedral(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right)
+{
+    const T *srcR = static_cast<const T *>(src[0]);
+    const T *srcG = static_cast<const T *>(src[1]);
+    const T *srcB = static_cast<const T *>(src[2]);
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const int n = lut.size;
+    const __m256 scale = _mm256_set1_ps(lut.scale);
+    const __m256 peak = _mm256_set1_ps(lut.peak);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i limit = _mm256_set1_epi32(n - 2);
+    const __m256i strideR = _mm256_set1_epi32(n * n * 4);
+    const __m256i strideG = _mm256_set1_epi32(n * 4);
+    const __m256i strideB = _mm256_set1_epi32(4);
+    const __m256i strideSum = _mm256_set1_epi32(n * n * 4 + n * 4 + 4);
+
+    for (int x = left; x < right; x += 8)
+    {
+        __m256 r = _mm256_mul_ps(_mm256_cvtepi32_ps(loadSamples(srcR + x)), scale);
+        __m256 g = _mm256_mul_ps(_mm256_cvtepi32_ps(loadSamples(srcG + x)), scale);
+        __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(loadSamples(srcB + x)), scale);
+        __m256i ir = _mm256_min_epi32(_mm256_cvttps_epi32(r), limit);
+        __m256i ig = _mm256_min_epi32(_mm256_cvttps_epi32(g), limit);
+        __m256i ib = _mm256_min_epi32(_mm256_cvttps_epi32(b), limit);
+        r = _mm256_sub_ps(r, _mm256_cvtepi32_ps(ir));
+        g = _mm256_sub_ps(g, _mm256_cvtepi32_ps(ig));
+        b = _mm256_sub_ps(b, _mm256_cvtepi32_ps(ib));
+
+        __m256 s0 = _mm256_max_ps(_mm256_max_ps(r, g), b);
+        __m256 s1 = _mm256_max_ps(_mm256_min_ps(r, g), _mm256_min_ps(_mm256_max_ps(r, g), b));
+        __m256 s2 = _mm256_min_ps(_mm256_min_ps(r, g), b);
+
+        __m256i rMax = _mm256_castps_si256(_mm256_and_ps(_mm256_cmp_ps(r, g, _CMP_GE_OQ), _mm256_cmp_ps(r, b, _CMP_GE_OQ)));
+        __m256i gAboveB = _mm256_castps_si256(_mm256_cmp_ps(g, b, _CMP_GE_OQ));
+        __m256i o0 = _mm256_blendv_epi8(_mm256_blendv_epi8(strideB, strideG, gAboveB), strideR, rMax);
+        __m256i bMin = _mm256_castps_si256(_mm256_and_ps(_mm256_cmp_ps(b, g, _CMP_LE_OQ), _mm256_cmp_ps(b, r, _CMP_LE_OQ)));
+        __m256i gBelowR = _mm256_castps_si256(_mm256_cmp_ps(g, r, _CMP_LE_OQ));
+        __m256i o2 = _mm256_blendv_epi8(_mm256_blendv_epi8(strideR, strideG, gBelowR), strideB, bMin);
+
+        __m256i v0 = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(ir, strideR), _mm256_mullo_epi32(ig, strideG)), _mm256_mullo_epi32(ib, strideB));
+        __m256i v1 = _mm256_add_epi32(v0, o0);
+        __m256i v3 = _mm256_add_epi32(v0, strideSum);
+        __m256i v2 = _mm256_sub_epi32(v3, o2);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            __m256 v = interpolate(lut.table + c, v0, v1, v2, v3, s0, s1, s2);
+            v = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), peak), half);
+            storeSamples(dstp[c] + x, _mm256_cvttps_epi32(v));
+        }
+    }
+}
+
+} // namespace
+
+void lutTetrahedral_avx2(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right)
+{
+    if (lut.bytesPerSample == 1)
+        tetrahedral<uint8_t>(lut, src, dst, left, right);
+    else
+        tetrahedral<uint16_t>(lut, src, dst, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD
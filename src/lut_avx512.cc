@@ -0,0 +1,114 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <immintrin.h>
+#include "lut_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m512i loadSamples(const T *src);
+
+template <>
+__m512i loadSamples<uint8_t>(const uint8_t *src)
+{
+    return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+}
+
+template <>
+__m512i loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+}
+
+// Values are already clamped, the saturating narrowing only drops the upper bits
+void storeSamples(uint8_t *dst, __m512i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm512_cvtusepi32_epi8(v));
+}
+
+void storeSamples(uint16_t *dst, __m512i v)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm512_cvtusepi32_epi16(v));
+}
+
+// Interpolates one channel of sixteen pixels from the gathered vertices
+__m512 interpolate(const float *table, __m512i v0, __m512i v1, __m512i v2, __m512i v3, __m512 s0, __m512 s1, __m512 s2)
+{
+    __m512 c0 = _mm512_i32gather_ps(v0, table, 4);
+    __m512 c1 = _mm512_i32gather_ps(v1, table, 4);
+    __m512 c2 = _mm512_i32gather_ps(v2, table, 4);
+    __m512 c3 = _mm512_i32gather_ps(v3, table, 4);
+    __m512 v = _mm512_add_ps(c0, _mm512_mul_ps(_mm512_sub_ps(c1, c0), s0));
+    v = _mm512_add_ps(v, _mm512_mul_ps(_mm512_sub_ps(c2, c1), s1));
+    return _mm512_add_ps(v, _mm512_mul_ps(_mm512_sub_ps(c3, c2), s2));
+}
+
+// Sixteen pixels per iteration, each vertex channel is gathered from the table
+template <typename T>
+void tetrahedral(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right)
+{
+    const T *srcR = static_cast<const T *>(src[0]);
+    const T *srcG = static_cast<const T *>(src[1]);
+    const T *srcB = static_cast<const T *>(src[2]);
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const int n = lut.size;
+    const __m512 scale = _mm512_set1_ps(lut.scale);
+    const __m512 peak = _mm512_set1_ps(lut.peak);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512i limit = _mm512_set1_epi32(n - 2);
+    const __m512i strideR = _mm512_set1_epi32(n * n * 4);
+    const __m512i strideG = _mm512_set1_epi32(n * 4);
+    const __m512i strideB = _mm512_set1_epi32(4);
+    const __m512i strideSum = _mm512_set1_epi32(n * n * 4 + n * 4 + 4);
+
+    for (int x = left; x < right; x += 16)
+    {
+        __m512 r = _mm512_mul_ps(_mm512_cvtepi32_ps(loadSamples(srcR + x)), scale);
+        __m512 g = _mm512_mul_ps(_mm512_cvtepi32_ps(loadSamples(srcG + x)), scale);
+        __m512 b = _mm512_mul_ps(_mm512_cvtepi32_ps(loadSamples(srcB + x)), scale);
+        __m512i ir = _mm512_min_epi32(_mm512_cvttps_epi32(r), limit);
+        __m512i ig = _mm512_min_epi32(_mm512_cvttps_epi32(g), limit);
+        __m512i ib = _mm512_min_epi32(_mm512_cvttps_epi32(b), limit);
+        r = _mm512_sub_ps(r, _mm512_cvtepi32_ps(ir));
+        g = _mm512_sub_ps(g, _mm512_cvtepi32_ps(ig));
+        b = _mm512_sub_ps(b, _mm512_cvtepi32_ps(ib));
+
+        __m512 s0 = _mm512_max_ps(_mm512_max_ps(r, g), b);
+        __m512 s1 = _mm512_max_ps(_mm512_min_ps(r, g), _mm512_min_ps(_mm512_max_ps(r, g), b));
+        __m512 s2 = _mm512_min_ps(_mm512_min_ps(r, g), b);
+
+        __mmask16 rMax = _mm512_cmp_ps_mask(r, g, _CMP_GE_OQ) & _mm512_cmp_ps_mask(r, b, _CMP_GE_OQ);
+        __mmask16 gAboveB = _mm512_cmp_ps_mask(g, b, _CMP_GE_OQ);
+        __m512i o0 = _mm512_mask_blend_epi32(rMax, _mm512_mask_blend_epi32(gAboveB, strideB, strideG), strideR);
+        __mmask16 bMin = _mm512_cmp_ps_mask(b, g, _CMP_LE_OQ) & _mm512_cmp_ps_mask(b, r, _CMP_LE_OQ);
+        __mmask16 gBelowR = _mm512_cmp_ps_mask(g, r, _CMP_LE_OQ);
+        __m512i o2 = _mm512_mask_blend_epi32(bMin, _mm512_mask_blend_epi32(gBelowR, strideR, strideG), strideB);
+
+        __m512i v0 = _mm512_add_epi32(_mm512_add_epi32(_mm512_mullo_epi32(ir, strideR), _mm512_mullo_epi32(ig, strideG)), _mm512_mullo_epi32(ib, strideB));
+        __m512i v1 = _mm512_add_epi32(v0, o0);
+        __m512i v3 = _mm512_add_epi32(v0, strideSum);
+        __m512i v2 = _mm512_sub_epi32(v3, o2);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            __m512 v = interpolate(lut.table + c, v0, v1, v2, v3, s0, s1, s2);
+            v = _mm512_add_ps(_mm512_min_ps(_mm512_max_ps(v, _mm512_setzero_ps()), peak), half);
+            storeSamples(dstp[c] + x, _mm512_cvttps_epi32(v));
+        }
+    }
+}
+
+} // namespace
+
+void lutTetrahedral_avx512(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right)
+{
+    if (lut.bytesPerSample == 1)
+        tetrahedral<uint8_t>(lut, src, dst, left, right);
+    else
+        tetrahedral<uint16_t>(lut, src, dst, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD
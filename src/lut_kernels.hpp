@@ -0,0 +1,29 @@
+#ifndef _ICCC_LUT_KERNELS
+#define _ICCC_LUT_KERNELS
+
+#include <cstddef>
+#include <cstdint>
+
+// A 3D LUT sampled from a transform, evaluated with tetrahedral interpolation.
+// Each node holds R, G, B and a padding float, already scaled to the output range.
+struct lutTable
+{
+    int size = 0;
+    const float *table = nullptr;
+    // Input value to grid coordinate
+    float scale = 0.0f;
+    // Largest output value
+    float peak = 0.0f;
+    int bytesPerSample = 0;
+};
+
+// Converts pixels [left, right) of one row from planar R, G, B to planar R, G, B.
+// SIMD kernels require right - left to be a multiple of their vector width.
+typedef void (*lutKernel)(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right);
+
+void lutTetrahedral_c(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right);
+void lutTetrahedral_sse41(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right);
+void lutTetrahedral_avx2(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right);
+void lutTetrahedral_avx512(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right);
+
+#endif
@@ -0,0 +1,132 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <cstring>
+#include <smmintrin.h>
+#include "lut_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m128i loadSamples(const T *src);
+
+template <>
+__m128i loadSamples<uint8_t>(const uint8_t *src)
+{
+    int32_t v;
+    memcpy(&v, src, sizeof(v));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+}
+
+template <>
+__m128i loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+}
+
+void storeSamples(uint8_t *dst, __m128i v)
+{
+    v = _mm_packus_epi32(v, v);
+    v = _mm_packus_epi16(v, v);
+    int32_t out = _mm_cvtsi128_si32(v);
+    memcpy(dst, &out, sizeof(out));
+}
+
+void storeSamples(uint16_t *dst, __m128i v)
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi32(v, v));
+}
+
+// Four pixels per iteration: coordinates in SIMD, then one RGBx node load per vertex and pixel
+template <typename T>
+void tetrahedral(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right)
+{
+    const T *srcR = static_cast<const T *>(src[0]);
+    const T *srcG = static_cast<const T *>(src[1]);
+    const T *srcB = static_cast<const T *>(src[2]);
+    T *dstR = static_cast<T *>(dst[0]);
+    T *dstG = static_cast<T *>(dst[1]);
+    T *dstB = static_cast<T *>(dst[2]);
+
+    const int n = lut.size;
+    const __m128 scale = _mm_set1_ps(lut.scale);
+    const __m128 peak = _mm_set1_ps(lut.peak);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i limit = _mm_set1_epi32(n - 2);
+    const __m128i strideR = _mm_set1_epi32(n * n * 4);
+    const __m128i strideG = _mm_set1_epi32(n * 4);
+    const __m128i strideB = _mm_set1_epi32(4);
+    const __m128i strideSum = _mm_set1_epi32(n * n * 4 + n * 4 + 4);
+
+    alignas(16) int32_t idx0[4], idx1[4], idx2[4], idx3[4];
+    alignas(16) float w0[4], w1[4], w2[4];
+
+    for (int x = left; x < right; x += 4)
+    {
+        __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(loadSamples(srcR + x)), scale);
+        __m128 g = _mm_mul_ps(_mm_cvtepi32_ps(loadSamples(srcG + x)), scale);
+        __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(loadSamples(srcB + x)), scale);
+        __m128i ir = _mm_min_epi32(_mm_cvttps_epi32(r), limit);
+        __m128i ig = _mm_min_epi32(_mm_cvttps_epi32(g), limit);
+        __m128i ib = _mm_min_epi32(_mm_cvttps_epi32(b), limit);
+        r = _mm_sub_ps(r, _mm_cvtepi32_ps(ir));
+        g = _mm_sub_ps(g, _mm_cvtepi32_ps(ig));
+        b = _mm_sub_ps(b, _mm_cvtepi32_ps(ib));
+
+        __m128 s0 = _mm_max_ps(_mm_max_ps(r, g), b);
+        __m128 s1 = _mm_max_ps(_mm_min_ps(r, g), _mm_min_ps(_mm_max_ps(r, g), b));
+        __m128 s2 = _mm_min_ps(_mm_min_ps(r, g), b);
+
+        __m128i rMax = _mm_castps_si128(_mm_and_ps(_mm_cmpge_ps(r, g), _mm_cmpge_ps(r, b)));
+        __m128i gAboveB = _mm_castps_si128(_mm_cmpge_ps(g, b));
+        __m128i o0 = _mm_blendv_epi8(_mm_blendv_epi8(strideB, strideG, gAboveB), strideR, rMax);
+        __m128i bMin = _mm_castps_si128(_mm_and_ps(_mm_cmple_ps(b, g), _mm_cmple_ps(b, r)));
+        __m128i gBelowR = _mm_castps_si128(_mm_cmple_ps(g, r));
+        __m128i o2 = _mm_blendv_epi8(_mm_blendv_epi8(strideR, strideG, gBelowR), strideB, bMin);
+
+        __m128i base = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(ir, strideR), _mm_mullo_epi32(ig, strideG)), _mm_mullo_epi32(ib, strideB));
+        __m128i v1 = _mm_add_epi32(base, o0);
+        __m128i v3 = _mm_add_epi32(base, strideSum);
+        __m128i v2 = _mm_sub_epi32(v3, o2);
+
+        _mm_store_si128(reinterpret_cast<__m128i *>(idx0), base);
+        _mm_store_si128(reinterpret_cast<__m128i *>(idx1), v1);
+        _mm_store_si128(reinterpret_cast<__m128i *>(idx2), v2);
+        _mm_store_si128(reinterpret_cast<__m128i *>(idx3), v3);
+        _mm_store_ps(w0, s0);
+        _mm_store_ps(w1, s1);
+        _mm_store_ps(w2, s2);
+
+        __m128 px[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128 c0 = _mm_load_ps(lut.table + idx0[i]);
+            __m128 c1 = _mm_load_ps(lut.table + idx1[i]);
+            __m128 c2 = _mm_load_ps(lut.table + idx2[i]);
+            __m128 c3 = _mm_load_ps(lut.table + idx3[i]);
+            __m128 v = _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), _mm_set1_ps(w0[i])));
+            v = _mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(c2, c1), _mm_set1_ps(w1[i])));
+            px[i] = _mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(c3, c2), _mm_set1_ps(w2[i])));
+        }
+        _MM_TRANSPOSE4_PS(px[0], px[1], px[2], px[3]);
+
+        for (int c = 0; c < 3; ++c)
+            px[c] = _mm_add_ps(_mm_min_ps(_mm_max_ps(px[c], _mm_setzero_ps()), peak), half);
+        storeSamples(dstR + x, _mm_cvttps_epi32(px[0]));
+        storeSamples(dstG + x, _mm_cvttps_epi32(px[1]));
+        storeSamples(dstB + x, _mm_cvttps_epi32(px[2]));
+    }
+}
+
+} // namespace
+
+void lutTetrahedral_sse41(const lutTable &lut, const void * const src[3], void * const dst[3], int left, int right)
+{
+    if (lut.bytesPerSample == 1)
+        tetrahedral<uint8_t>(lut, src, dst, left, right);
+    else
+        tetrahedral<uint16_t>(lut, src, dst, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD
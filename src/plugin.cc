@@ -2,6 +2,7 @@
 
 extern void VS_CC icccCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
 extern void VS_CC iccpCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
+extern void VS_CC statsCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
 extern void VS_CC tagCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin* plugin, const VSPLUGINAPI* vspapi)
@@ -19,7 +20,16 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin* plugin, const VSPLUGINAPI
         "gamut_warning_color:int[]:opt;"
         "black_point_compensation:int:opt;"
         "clut_size:int:opt;"
-        "prefer_props:int:opt;",
+        "prefer_props:int:opt;"
+        "threads:int:opt;"
+        "engine:data:opt;"
+        "cache_mb:int:opt;"
+        "prefetch:int:opt;"
+        "warmup:data[]:opt;"
+        "disk_cache:int:opt;"
+        "format:int:opt;"
+        "dither:data:opt;"
+        "stats:int:opt;",
         "clip:vnode;",
         icccCreate, nullptr, plugin
     );
@@ -33,7 +43,13 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin* plugin, const VSPLUGINAPI
         "intent:data:opt;"
         "black_point_compensation:int:opt;"
         "clut_size:int:opt;"
-        "inverse:int:opt;",
+        "inverse:int:opt;"
+        "threads:int:opt;"
+        "engine:data:opt;"
+        "disk_cache:int:opt;"
+        "format:int:opt;"
+        "dither:data:opt;"
+        "stats:int:opt;",
         "clip:vnode;",
         iccpCreate, nullptr, plugin
     );
@@ -45,4 +61,19 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin* plugin, const VSPLUGINAPI
         "clip:vnode;",
         tagCreate, nullptr, plugin
     );
+
+    vspapi->registerFunction("Stats",
+        "",
+        "filter:data[]:opt;"
+        "id:int[]:opt;"
+        "frames:int[]:opt;"
+        "pack_ns:int[]:opt;"
+        "transform_ns:int[]:opt;"
+        "unpack_ns:int[]:opt;"
+        "cache_hits:int[]:opt;"
+        "cache_misses:int[]:opt;"
+        "build_ns:int[]:opt;"
+        "bytes_allocated:int[]:opt;",
+        statsCreate, nullptr, plugin
+    );
 }
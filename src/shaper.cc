@@ -0,0 +1,286 @@
+#include "shaper.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <memory>
+
+template <typename T>
+static void matrixShaper(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right)
+{
+    const T *srcR = static_cast<const T *>(src[0]);
+    const T *srcG = static_cast<const T *>(src[1]);
+    const T *srcB = static_cast<const T *>(src[2]);
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    float lowest;
+    memcpy(&lowest, &shaperOutputMin, sizeof(lowest));
+
+    // Keep the operation order in sync with the SIMD kernels, so that results are identical on every CPU
+    for (int x = left; x < right; ++x)
+    {
+        float r = st.input[0][srcR[x]];
+        float g = st.input[1][srcG[x]];
+        float b = st.input[2][srcB[x]];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            float v = st.matrix[c * 3] * r + st.matrix[c * 3 + 1] * g + st.matrix[c * 3 + 2] * b + st.offset[c];
+            v = v > lowest ? v : lowest;
+            v = v < 1.0f ? v : 1.0f;
+            uint32_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            const float *t = st.output[c] + ((bits - shaperOutputMin) >> shaperOutputShift);
+            float frac = static_cast<float>(bits & ((1u << shaperOutputShift) - 1)) * (1.0f / (1 << shaperOutputShift));
+            dstp[c][x] = static_cast<T>(t[0] + (t[1] - t[0]) * frac + 0.5f);
+        }
+    }
+}
+
+void shaperMatrix_c(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right)
+{
+    if (st.bytesPerSample == 1)
+        matrixShaper<uint8_t>(st, src, dst, left, right);
+    else
+        matrixShaper<uint16_t>(st, src, dst, left, right);
+}
+
+// lcms takes any LUT based tag over the matrix and curves
+static bool isMatrixShaper(cmsHPROFILE profile, bool asInput)
+{
+    static const cmsTagSignature inputTags[] = {cmsSigAToB0Tag, cmsSigAToB1Tag, cmsSigAToB2Tag, cmsSigDToB0Tag, cmsSigDToB1Tag, cmsSigDToB2Tag};
+    static const cmsTagSignature outputTags[] = {cmsSigBToA0Tag, cmsSigBToA1Tag, cmsSigBToA2Tag, cmsSigBToD0Tag, cmsSigBToD1Tag, cmsSigBToD2Tag};
+
+    if (cmsGetColorSpace(profile) != cmsSigRgbData || !cmsIsMatrixShaper(profile))
+        return false;
+    for (auto tag : asInput ? inputTags : outputTags)
+    {
+        if (cmsIsTag(profile, tag)) return false;
+    }
+    return true;
+}
+
+// RGB to PCS XYZ from the colorant tags, row major
+static bool readColorants(cmsHPROFILE profile, double m[9])
+{
+    const cmsTagSignature tags[3] = {cmsSigRedColorantTag, cmsSigGreenColorantTag, cmsSigBlueColorantTag};
+    for (int c = 0; c < 3; ++c)
+    {
+        const cmsCIEXYZ *xyz = reinterpret_cast<const cmsCIEXYZ *>(cmsReadTag(profile, tags[c]));
+        if (!xyz) return false;
+        m[c] = xyz->X;
+        m[3 + c] = xyz->Y;
+        m[6 + c] = xyz->Z;
+    }
+    return true;
+}
+
+static bool invert(const double m[9], double inv[9])
+{
+    inv[0] = m[4] * m[8] - m[5] * m[7];
+    inv[1] = m[2] * m[7] - m[1] * m[8];
+    inv[2] = m[1] * m[5] - m[2] * m[4];
+    inv[3] = m[5] * m[6] - m[3] * m[8];
+    inv[4] = m[0] * m[8] - m[2] * m[6];
+    inv[5] = m[2] * m[3] - m[0] * m[5];
+    inv[6] = m[3] * m[7] - m[4] * m[6];
+    inv[7] = m[1] * m[6] - m[0] * m[7];
+    inv[8] = m[0] * m[4] - m[1] * m[3];
+    double det = m[0] * inv[0] + m[1] * inv[3] + m[2] * inv[6];
+    if (std::fabs(det) < 1e-12) return false;
+    for (int i = 0; i < 9; ++i)
+        inv[i] /= det;
+    return true;
+}
+
+shaperEngine *shaperEngine::create(cmsHPROFILE input, cmsHPROFILE output, cmsUInt32Number intent, cmsUInt32Number flags, int bytesPerSample)
+{
+    if (bytesPerSample != 1 && bytesPerSample != 2)
+        return nullptr;
+    // Absolute intent, proofing and gamut check are left to lcms
+    if (intent != INTENT_PERCEPTUAL && intent != INTENT_RELATIVE_COLORIMETRIC && intent != INTENT_SATURATION)
+        return nullptr;
+    if (flags & (cmsFLAGS_SOFTPROOFING | cmsFLAGS_GAMUTCHECK))
+        return nullptr;
+    if (!isMatrixShaper(input, true) || !isMatrixShaper(output, false))
+        return nullptr;
+
+    double toPCS[9], toOutput[9], fromPCS[9];
+    if (!readColorants(input, toPCS) || !readColorants(output, toOutput) || !invert(toOutput, fromPCS))
+        return nullptr;
+
+    // Black point compensation scales XYZ around the white point.
+    // Like lcms, it's forced for V4 output profiles with perceptual and saturation intents.
+    double scale[3] = {1.0, 1.0, 1.0};
+    double shift[3] = {0.0, 0.0, 0.0};
+    bool bpc = (flags & cmsFLAGS_BLACKPOINTCOMPENSATION) || (intent != INTENT_RELATIVE_COLORIMETRIC && cmsGetEncodedICCversion(output) >= 0x4000000);
+    if (bpc)
+    {
+        cmsCIEXYZ blackIn = {0.0, 0.0, 0.0};
+        cmsCIEXYZ blackOut = {0.0, 0.0, 0.0};
+        cmsDetectBlackPoint(&blackIn, input, intent, 0);
+        cmsDetectDestinationBlackPoint(&blackOut, output, intent, 0);
+        if (blackIn.X != blackOut.X || blackIn.Y != blackOut.Y || blackIn.Z != blackOut.Z)
+        {
+            const cmsCIEXYZ *white = cmsD50_XYZ();
+            const double bpIn[3] = {blackIn.X, blackIn.Y, blackIn.Z};
+            const double bpOut[3] = {blackOut.X, blackOut.Y, blackOut.Z};
+            const double wp[3] = {white->X, white->Y, white->Z};
+            for (int c = 0; c < 3; ++c)
+            {
+                double t = bpIn[c] - wp[c];
+                scale[c] = (bpOut[c] - wp[c]) / t;
+                shift[c] = -wp[c] * (bpOut[c] - bpIn[c]) / t;
+            }
+        }
+    }
+
+    std::unique_ptr<shaperEngine> engine(new shaperEngine());
+    shaperTable &st = engine->st;
+    st.bytesPerSample = bytesPerSample;
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            double sum = 0.0;
+            for (int k = 0; k < 3; ++k)
+                sum += fromPCS[r * 3 + k] * scale[k] * toPCS[k * 3 + c];
+            st.matrix[r * 3 + c] = static_cast<float>(sum);
+        }
+        double sum = 0.0;
+        for (int k = 0; k < 3; ++k)
+            sum += fromPCS[r * 3 + k] * shift[k];
+        st.offset[r] = static_cast<float>(sum);
+    }
+
+    // Input curves are exact for every code, output curves are inverted like lcms does
+    const cmsTagSignature trcTags[3] = {cmsSigRedTRCTag, cmsSigGreenTRCTag, cmsSigBlueTRCTag};
+    int codes = bytesPerSample == 1 ? 256 : 65536;
+    engine->peak = static_cast<float>(codes - 1);
+    engine->inputCurves.resize(static_cast<size_t>(codes) * 3);
+    engine->outputCurves.resize(static_cast<size_t>(shaperOutputSize) * 3);
+    for (int c = 0; c < 3; ++c)
+    {
+        const cmsToneCurve *inputCurve = reinterpret_cast<const cmsToneCurve *>(cmsReadTag(input, trcTags[c]));
+        const cmsToneCurve *outputCurve = reinterpret_cast<const cmsToneCurve *>(cmsReadTag(output, trcTags[c]));
+        if (!inputCurve || !outputCurve)
+            return nullptr;
+        cmsToneCurve *inverse = cmsReverseToneCurve(outputCurve);
+        if (!inverse)
+            return nullptr;
+
+        float *in = &engine->inputCurves[static_cast<size_t>(c) * codes];
+        for (int i = 0; i < codes; ++i)
+        {
+            in[i] = cmsEvalToneCurveFloat(inputCurve, i / engine->peak);
+            // Broken curves, e.g. from invalid parameters, are left to lcms
+            if (!std::isfinite(in[i]))
+            {
+                cmsFreeToneCurve(inverse);
+                return nullptr;
+            }
+        }
+
+        float *out = &engine->outputCurves[static_cast<size_t>(c) * shaperOutputSize];
+        for (int i = 0; i < shaperOutputSize; ++i)
+        {
+            uint32_t bits = std::min(shaperOutputMin + (static_cast<uint32_t>(i) << shaperOutputShift), shaperOutputMax);
+            float x;
+            memcpy(&x, &bits, sizeof(x));
+            float y = cmsEvalToneCurveFloat(inverse, x);
+            if (!std::isfinite(y))
+            {
+                cmsFreeToneCurve(inverse);
+                return nullptr;
+            }
+            out[i] = std::min(std::max(y, 0.0f), 1.0f) * engine->peak;
+        }
+        cmsFreeToneCurve(inverse);
+
+        st.input[c] = in;
+        st.output[c] = out;
+    }
+
+    // Compare against the float pipeline of lcms on a grid of input codes, clipped like 16 bit transforms.
+    // Anything unexpected in the profiles shows up here and falls back to lcms.
+    cmsHTRANSFORM reference = cmsCreateTransform(input, TYPE_RGB_16, output, TYPE_RGB_FLT, intent, (flags & cmsFLAGS_BLACKPOINTCOMPENSATION) | cmsFLAGS_NOOPTIMIZE);
+    if (!reference)
+        return nullptr;
+    constexpr int steps = 9;
+    constexpr float tolerance = 1.0f / 65536;
+    std::vector<int> grid;
+    std::vector<cmsUInt16Number> samples;
+    for (int i = 0; i < steps * steps * steps; ++i)
+    {
+        int index[3] = {i / (steps * steps), i / steps % steps, i % steps};
+        for (int c = 0; c < 3; ++c)
+        {
+            int code = (index[c] * (codes - 1) + (steps - 1) / 2) / (steps - 1);
+            grid.push_back(code);
+            samples.push_back(static_cast<cmsUInt16Number>(bytesPerSample == 1 ? code * 257 : code));
+        }
+    }
+    std::vector<cmsFloat32Number> expected(samples.size());
+    cmsDoTransform(reference, samples.data(), expected.data(), steps * steps * steps);
+    cmsDeleteTransform(reference);
+    for (int i = 0; i < steps * steps * steps; ++i)
+    {
+        float result[3];
+        engine->evaluate(&grid[i * 3], result);
+        for (int c = 0; c < 3; ++c)
+        {
+            if (std::fabs(result[c] - std::min(std::max(expected[i * 3 + c], 0.0f), 1.0f)) > tolerance)
+                return nullptr;
+        }
+    }
+
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    simdLevel level = getSimdLevel();
+    if (level == simdLevel::avx512)
+    {
+        engine->kernel = shaperMatrix_avx512;
+        engine->vectorWidth = 16;
+    }
+    else if (level == simdLevel::avx2)
+    {
+        engine->kernel = shaperMatrix_avx2;
+        engine->vectorWidth = 8;
+    }
+    else if (level == simdLevel::sse41)
+    {
+        engine->kernel = shaperMatrix_sse41;
+        engine->vectorWidth = 4;
+    }
+#endif
+
+    return engine.release();
+}
+
+void shaperEngine::evaluate(const int code[3], float out[3]) const
+{
+    float lowest;
+    memcpy(&lowest, &shaperOutputMin, sizeof(lowest));
+    float r = st.input[0][code[0]];
+    float g = st.input[1][code[1]];
+    float b = st.input[2][code[2]];
+    for (int c = 0; c < 3; ++c)
+    {
+        float v = st.matrix[c * 3] * r + st.matrix[c * 3 + 1] * g + st.matrix[c * 3 + 2] * b + st.offset[c];
+        v = v > lowest ? v : lowest;
+        v = v < 1.0f ? v : 1.0f;
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        const float *t = st.output[c] + ((bits - shaperOutputMin) >> shaperOutputShift);
+        float frac = static_cast<float>(bits & ((1u << shaperOutputShift) - 1)) * (1.0f / (1 << shaperOutputShift));
+        out[c] = (t[0] + (t[1] - t[0]) * frac) / peak;
+    }
+}
+
+void shaperEngine::apply(const void * const src[3], void * const dst[3], int width) const
+{
+    int body = kernel ? width - width % vectorWidth : 0;
+    if (body > 0)
+        kernel(st, src, dst, 0, body);
+    if (body < width)
+        shaperMatrix_c(st, src, dst, body, width);
+}
@@ -0,0 +1,39 @@
+#ifndef _ICCC_SHAPER
+#define _ICCC_SHAPER
+
+#include "common.hpp"
+#include "shaper_kernels.hpp"
+
+class shaperEngine : public planarEngine
+{
+public:
+    // Builds the matrix-shaper pipeline between two RGB matrix/TRC profiles as lcms would link them.
+    // Returns null if the profiles aren't matrix-shapers, the flags need lcms, or the result doesn't match lcms.
+    static shaperEngine *create(cmsHPROFILE input, cmsHPROFILE output, cmsUInt32Number intent, cmsUInt32Number flags, int bytesPerSample);
+
+    shaperEngine(const shaperEngine &) = delete;
+    shaperEngine &operator=(const shaperEngine &) = delete;
+
+    // Converts one row of planar samples in the format given on creation
+    void apply(const void * const src[3], void * const dst[3], int width) const override;
+
+    size_t footprint() const override
+    {
+        return (inputCurves.size() + outputCurves.size()) * sizeof(float);
+    }
+
+private:
+    shaperEngine() = default;
+
+    // Output of the given input codes in [0, 1] before rounding
+    void evaluate(const int code[3], float out[3]) const;
+
+    std::vector<float> inputCurves;
+    std::vector<float> outputCurves;
+    shaperTable st;
+    shaperKernel kernel = nullptr;
+    int vectorWidth = 1;
+    float peak = 0.0f;
+};
+
+#endif
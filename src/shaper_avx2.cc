@@ -0,0 +1,89 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <immintrin.h>
+#include "shaper_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m256i loadSamples(const T *src);
+
+template <>
+__m256i loadSamples<uint8_t>(const uint8_t *src)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+}
+
+template <>
+__m256i loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+}
+
+void storeSamples(uint8_t *dst, __m256i v)
+{
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(w, w));
+}
+
+void storeSamples(uint16_t *dst, __m256i v)
+{
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), w);
+}
+
+// Eight pixels per iteration, table lookups are gathered
+template <typename T>
+void matrixShaper(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right)
+{
+    const T *srcp[3] = {static_cast<const T *>(src[0]), static_cast<const T *>(src[1]), static_cast<const T *>(src[2])};
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const __m256 lowest = _mm256_castsi256_ps(_mm256_set1_epi32(shaperOutputMin));
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i base = _mm256_set1_epi32(shaperOutputMin);
+    const __m256i fracMask = _mm256_set1_epi32((1 << shaperOutputShift) - 1);
+    const __m256 fracScale = _mm256_set1_ps(1.0f / (1 << shaperOutputShift));
+    __m256 matrix[9], offset[3];
+    for (int i = 0; i < 9; ++i)
+        matrix[i] = _mm256_set1_ps(st.matrix[i]);
+    for (int c = 0; c < 3; ++c)
+        offset[c] = _mm256_set1_ps(st.offset[c]);
+
+    for (int x = left; x < right; x += 8)
+    {
+        __m256 rgb[3];
+        for (int c = 0; c < 3; ++c)
+            rgb[c] = _mm256_i32gather_ps(st.input[c], loadSamples(srcp[c] + x), 4);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            __m256 v = _mm256_add_ps(_mm256_mul_ps(matrix[c * 3], rgb[0]), _mm256_mul_ps(matrix[c * 3 + 1], rgb[1]));
+            v = _mm256_add_ps(_mm256_add_ps(v, _mm256_mul_ps(matrix[c * 3 + 2], rgb[2])), offset[c]);
+            v = _mm256_min_ps(_mm256_max_ps(v, lowest), one);
+
+            __m256i bits = _mm256_castps_si256(v);
+            __m256i idx = _mm256_srli_epi32(_mm256_sub_epi32(bits, base), shaperOutputShift);
+            __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(bits, fracMask)), fracScale);
+            __m256 t0 = _mm256_i32gather_ps(st.output[c], idx, 4);
+            __m256 t1 = _mm256_i32gather_ps(st.output[c] + 1, idx, 4);
+            v = _mm256_add_ps(_mm256_add_ps(t0, _mm256_mul_ps(_mm256_sub_ps(t1, t0), frac)), half);
+            storeSamples(dstp[c] + x, _mm256_cvttps_epi32(v));
+        }
+    }
+}
+
+} // namespace
+
+void shaperMatrix_avx2(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right)
+{
+    if (st.bytesPerSample == 1)
+        matrixShaper<uint8_t>(st, src, dst, left, right);
+    else
+        matrixShaper<uint16_t>(st, src, dst, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD
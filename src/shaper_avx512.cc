@@ -0,0 +1,88 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <immintrin.h>
+#include "shaper_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m512i loadSamples(const T *src);
+
+template <>
+__m512i loadSamples<uint8_t>(const uint8_t *src)
+{
+    return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+}
+
+template <>
+__m512i loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+}
+
+// Values are already in range, the saturating narrowing only drops the upper bits
+void storeSamples(uint8_t *dst, __m512i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm512_cvtusepi32_epi8(v));
+}
+
+void storeSamples(uint16_t *dst, __m512i v)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm512_cvtusepi32_epi16(v));
+}
+
+// Sixteen pixels per iteration, table lookups are gathered
+template <typename T>
+void matrixShaper(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right)
+{
+    const T *srcp[3] = {static_cast<const T *>(src[0]), static_cast<const T *>(src[1]), static_cast<const T *>(src[2])};
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const __m512 lowest = _mm512_castsi512_ps(_mm512_set1_epi32(shaperOutputMin));
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512i base = _mm512_set1_epi32(shaperOutputMin);
+    const __m512i fracMask = _mm512_set1_epi32((1 << shaperOutputShift) - 1);
+    const __m512 fracScale = _mm512_set1_ps(1.0f / (1 << shaperOutputShift));
+    __m512 matrix[9], offset[3];
+    for (int i = 0; i < 9; ++i)
+        matrix[i] = _mm512_set1_ps(st.matrix[i]);
+    for (int c = 0; c < 3; ++c)
+        offset[c] = _mm512_set1_ps(st.offset[c]);
+
+    for (int x = left; x < right; x += 16)
+    {
+        __m512 rgb[3];
+        for (int c = 0; c < 3; ++c)
+            rgb[c] = _mm512_i32gather_ps(loadSamples(srcp[c] + x), st.input[c], 4);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            __m512 v = _mm512_add_ps(_mm512_mul_ps(matrix[c * 3], rgb[0]), _mm512_mul_ps(matrix[c * 3 + 1], rgb[1]));
+            v = _mm512_add_ps(_mm512_add_ps(v, _mm512_mul_ps(matrix[c * 3 + 2], rgb[2])), offset[c]);
+            v = _mm512_min_ps(_mm512_max_ps(v, lowest), one);
+
+            __m512i bits = _mm512_castps_si512(v);
+            __m512i idx = _mm512_srli_epi32(_mm512_sub_epi32(bits, base), shaperOutputShift);
+            __m512 frac = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_and_si512(bits, fracMask)), fracScale);
+            __m512 t0 = _mm512_i32gather_ps(idx, st.output[c], 4);
+            __m512 t1 = _mm512_i32gather_ps(idx, st.output[c] + 1, 4);
+            v = _mm512_add_ps(_mm512_add_ps(t0, _mm512_mul_ps(_mm512_sub_ps(t1, t0), frac)), half);
+            storeSamples(dstp[c] + x, _mm512_cvttps_epi32(v));
+        }
+    }
+}
+
+} // namespace
+
+void shaperMatrix_avx512(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right)
+{
+    if (st.bytesPerSample == 1)
+        matrixShaper<uint8_t>(st, src, dst, left, right);
+    else
+        matrixShaper<uint16_t>(st, src, dst, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD
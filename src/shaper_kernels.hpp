@@ -0,0 +1,36 @@
+#ifndef _ICCC_SHAPER_KERNELS
+#define _ICCC_SHAPER_KERNELS
+
+#include <cstddef>
+#include <cstdint>
+
+// Output curves are tabulated on the bit patterns of linear values in [2^-48, 1],
+// with 128 nodes per octave and linear interpolation in between.
+constexpr uint32_t shaperOutputMin = 0x27800000;
+constexpr uint32_t shaperOutputMax = 0x3F800000;
+constexpr int shaperOutputShift = 16;
+constexpr int shaperOutputSize = ((shaperOutputMax - shaperOutputMin) >> shaperOutputShift) + 2;
+
+// A matrix-shaper transform between two RGB profiles: input curves, a 3x3 matrix in linear light, output curves
+struct shaperTable
+{
+    // Linear value of each input code, per channel
+    const float *input[3] = {};
+    // Row major, and the offset from black point compensation
+    float matrix[9] = {};
+    float offset[3] = {};
+    // Output code of linear values, per channel
+    const float *output[3] = {};
+    int bytesPerSample = 0;
+};
+
+// Converts pixels [left, right) of one row from planar R, G, B to planar R, G, B.
+// SIMD kernels require right - left to be a multiple of their vector width.
+typedef void (*shaperKernel)(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right);
+
+void shaperMatrix_c(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right);
+void shaperMatrix_sse41(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right);
+void shaperMatrix_avx2(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right);
+void shaperMatrix_avx512(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right);
+
+#endif
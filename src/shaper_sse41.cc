@@ -0,0 +1,103 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <cstring>
+#include <smmintrin.h>
+#include "shaper_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m128i loadSamples(const T *src);
+
+template <>
+__m128i loadSamples<uint8_t>(const uint8_t *src)
+{
+    int32_t v;
+    memcpy(&v, src, sizeof(v));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+}
+
+template <>
+__m128i loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+}
+
+void storeSamples(uint8_t *dst, __m128i v)
+{
+    v = _mm_packus_epi32(v, v);
+    v = _mm_packus_epi16(v, v);
+    int32_t out = _mm_cvtsi128_si32(v);
+    memcpy(dst, &out, sizeof(out));
+}
+
+void storeSamples(uint16_t *dst, __m128i v)
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi32(v, v));
+}
+
+__m128 lookup(const float *table, const int32_t idx[4])
+{
+    return _mm_setr_ps(table[idx[0]], table[idx[1]], table[idx[2]], table[idx[3]]);
+}
+
+// Four pixels per iteration, table lookups are scalar
+template <typename T>
+void matrixShaper(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right)
+{
+    const T *srcp[3] = {static_cast<const T *>(src[0]), static_cast<const T *>(src[1]), static_cast<const T *>(src[2])};
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const __m128 lowest = _mm_castsi128_ps(_mm_set1_epi32(shaperOutputMin));
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i base = _mm_set1_epi32(shaperOutputMin);
+    const __m128i fracMask = _mm_set1_epi32((1 << shaperOutputShift) - 1);
+    const __m128 fracScale = _mm_set1_ps(1.0f / (1 << shaperOutputShift));
+    __m128 matrix[9], offset[3];
+    for (int i = 0; i < 9; ++i)
+        matrix[i] = _mm_set1_ps(st.matrix[i]);
+    for (int c = 0; c < 3; ++c)
+        offset[c] = _mm_set1_ps(st.offset[c]);
+
+    alignas(16) int32_t idx[4];
+
+    for (int x = left; x < right; x += 4)
+    {
+        __m128 rgb[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            _mm_store_si128(reinterpret_cast<__m128i *>(idx), loadSamples(srcp[c] + x));
+            rgb[c] = lookup(st.input[c], idx);
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            __m128 v = _mm_add_ps(_mm_mul_ps(matrix[c * 3], rgb[0]), _mm_mul_ps(matrix[c * 3 + 1], rgb[1]));
+            v = _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(matrix[c * 3 + 2], rgb[2])), offset[c]);
+            v = _mm_min_ps(_mm_max_ps(v, lowest), one);
+
+            __m128i bits = _mm_castps_si128(v);
+            _mm_store_si128(reinterpret_cast<__m128i *>(idx), _mm_srli_epi32(_mm_sub_epi32(bits, base), shaperOutputShift));
+            __m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(bits, fracMask)), fracScale);
+            __m128 t0 = lookup(st.output[c], idx);
+            __m128 t1 = lookup(st.output[c] + 1, idx);
+            v = _mm_add_ps(_mm_add_ps(t0, _mm_mul_ps(_mm_sub_ps(t1, t0), frac)), half);
+            storeSamples(dstp[c] + x, _mm_cvttps_epi32(v));
+        }
+    }
+}
+
+} // namespace
+
+void shaperMatrix_sse41(const shaperTable &st, const void * const src[3], void * const dst[3], int left, int right)
+{
+    if (st.bytesPerSample == 1)
+        matrixShaper<uint8_t>(st, src, dst, left, right);
+    else
+        matrixShaper<uint16_t>(st, src, dst, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD
@@ -0,0 +1,36 @@
+#ifndef _ICCC_SIMD
+#define _ICCC_SIMD
+
+#include "libp2p/simd/cpuinfo_x86.h"
+#include <algorithm>
+#include <atomic>
+
+enum class simdLevel
+{
+    none,
+    sse41,
+    avx2,
+    avx512,
+};
+
+// Highest kernels engines may pick when they are created, only lowered to compare kernels against each other
+inline std::atomic<simdLevel> &simdLimit()
+{
+    static std::atomic<simdLevel> limit{simdLevel::avx512};
+    return limit;
+}
+
+// Best kernels supported by the CPU within the limit
+inline simdLevel getSimdLevel()
+{
+    simdLevel level = simdLevel::none;
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    p2p::simd::X86Capabilities caps = p2p::simd::query_x86_capabilities();
+    if (caps.avx512f) level = simdLevel::avx512;
+    else if (caps.avx2) level = simdLevel::avx2;
+    else if (caps.sse41) level = simdLevel::sse41;
+#endif
+    return std::min(level, simdLimit().load());
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+
+struct statsField
+{
+    std::atomic<uint64_t> icccStats::*counter;
+    // Frame prop and key in the result of iccc.Stats()
+    const char *prop;
+    const char *key;
+};
+
+static const statsField statsFields[] = {
+    {&icccStats::frames, "_IcccStatsFrames", "frames"},
+    {&icccStats::passthroughFrames, "_IcccStatsPassthroughFrames", "passthrough_frames"},
+    {&icccStats::packNs, "_IcccStatsPackNs", "pack_ns"},
+    {&icccStats::transformNs, "_IcccStatsTransformNs", "transform_ns"},
+    {&icccStats::unpackNs, "_IcccStatsUnpackNs", "unpack_ns"},
+    {&icccStats::cacheHits, "_IcccStatsCacheHits", "cache_hits"},
+    {&icccStats::cacheMisses, "_IcccStatsCacheMisses", "cache_misses"},
+    {&icccStats::buildNs, "_IcccStatsBuildNs", "build_ns"},
+    {&icccStats::bytesAllocated, "_IcccStatsBytesAllocated", "bytes_allocated"},
+};
+
+static int64_t toInt(uint64_t value)
+{
+    return static_cast<int64_t>(std::min<uint64_t>(value, INT64_MAX));
+}
+
+void icccStats::setProps(VSMap *map, const VSAPI *vsapi) const
+{
+    for (const auto &field : statsFields)
+        vsapi->mapSetInt(map, field.prop, toInt((this->*field.counter).load(std::memory_order_relaxed)), maReplace);
+}
+
+std::string icccStats::summary() const
+{
+    auto ms = [](const std::atomic<uint64_t> &ns) { return ns.load(std::memory_order_relaxed) / 1e6; };
+    char line[512];
+    snprintf(line, sizeof(line), "iccc: %s #%" PRIu64 ": %" PRIu64 " frames (%" PRIu64 " passed through), pack %.1f ms, transform %.1f ms, unpack %.1f ms, "
+        "cache %" PRIu64 " hits / %" PRIu64 " misses, build %.1f ms, %.1f MiB allocated",
+        filter.c_str(), id, frames.load(std::memory_order_relaxed), passthroughFrames.load(std::memory_order_relaxed), ms(packNs), ms(transformNs), ms(unpackNs),
+        cacheHits.load(std::memory_order_relaxed), cacheMisses.load(std::memory_order_relaxed), ms(buildNs),
+        bytesAllocated.load(std::memory_order_relaxed) / 1048576.0);
+    return line;
+}
+
+struct statsRegistry
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<icccStats>> live;
+    uint64_t nextID = 1;
+};
+
+static statsRegistry &getStatsRegistry()
+{
+    static statsRegistry registry;
+    return registry;
+}
+
+void registerStats(const std::shared_ptr<icccStats> &stats)
+{
+    statsRegistry &registry = getStatsRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    stats->id = registry.nextID++;
+    registry.live.push_back(stats);
+}
+
+void unregisterStats(const icccStats *stats)
+{
+    statsRegistry &registry = getStatsRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto it = registry.live.begin(); it != registry.live.end(); ++it)
+    {
+        if (it->get() == stats)
+        {
+            registry.live.erase(it);
+            return;
+        }
+    }
+}
+
+// Returns one array element per live instance, in order of creation
+void VS_CC statsCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+    statsRegistry &registry = getStatsRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto &stats : registry.live)
+    {
+        vsapi->mapSetData(out, "filter", stats->filter.c_str(), -1, dtUtf8, maAppend);
+        vsapi->mapSetInt(out, "id", toInt(stats->id), maAppend);
+        for (const auto &field : statsFields)
+            vsapi->mapSetInt(out, field.key, toInt(((*stats).*field.counter).load(std::memory_order_relaxed)), maAppend);
+    }
+}
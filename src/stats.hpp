@@ -0,0 +1,45 @@
+#ifndef _ICCC_STATS
+#define _ICCC_STATS
+
+#include "common.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Counters of one filter instance, updated without locking. Times are in nanoseconds, summed over all threads.
+struct icccStats
+{
+    std::string filter;
+    uint64_t id = 0;
+    std::atomic<uint64_t> frames{0};
+    // Frames of identity transforms, passed through without any pixel work
+    std::atomic<uint64_t> passthroughFrames{0};
+    std::atomic<uint64_t> packNs{0};
+    std::atomic<uint64_t> transformNs{0};
+    std::atomic<uint64_t> unpackNs{0};
+    // Lookups of embedded profiles, and the transforms built for them or the defaults
+    std::atomic<uint64_t> cacheHits{0};
+    std::atomic<uint64_t> cacheMisses{0};
+    std::atomic<uint64_t> buildNs{0};
+    // Interleave buffers and transform tables
+    std::atomic<uint64_t> bytesAllocated{0};
+
+    void add(std::atomic<uint64_t> &counter, uint64_t value)
+    {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Sets the counters as _IcccStats* frame props
+    void setProps(VSMap *map, const VSAPI *vsapi) const;
+
+    // One line for the log
+    std::string summary() const;
+};
+
+// Lists the instance in iccc.Stats() until it's unregistered, and gives it an ID
+void registerStats(const std::shared_ptr<icccStats> &stats);
+void unregisterStats(const icccStats *stats);
+
+void VS_CC statsCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi);
+
+#endif
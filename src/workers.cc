@@ -0,0 +1,126 @@
+#include "workers.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+workerPool::workerPool(int threads)
+{
+    for (int i = 0; i < threads; ++i)
+        this->threads.emplace_back([this]() { loop(); });
+}
+
+workerPool::~workerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    for (auto &t : threads)
+        t.join();
+}
+
+void workerPool::loop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void workerPool::run(int count, const std::function<void(int)> &job)
+{
+    if (count <= 0) return;
+
+    // Jobs are claimed from a shared counter, so helpers that start late simply find nothing to do
+    struct group
+    {
+        std::atomic<int> next{0};
+        int done = 0;
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+    auto g = std::make_shared<group>();
+
+    auto work = [g, count, &job]()
+    {
+        int finished = 0;
+        for (int i = g->next++; i < count; i = g->next++)
+        {
+            job(i);
+            ++finished;
+        }
+        if (finished > 0)
+        {
+            std::lock_guard<std::mutex> lock(g->mutex);
+            g->done += finished;
+            if (g->done == count) g->cond.notify_all();
+        }
+    };
+
+    int helpers = std::min(count - 1, size());
+    if (helpers > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < helpers; ++i)
+                tasks.push(work);
+        }
+        if (helpers == 1) cond.notify_one();
+        else cond.notify_all();
+    }
+
+    work();
+
+    std::unique_lock<std::mutex> lock(g->mutex);
+    g->cond.wait(lock, [&]() { return g->done == count; });
+}
+
+backgroundQueue::backgroundQueue()
+{
+    thread = std::thread([this]() { loop(); });
+}
+
+backgroundQueue::~backgroundQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    cond.notify_one();
+    thread.join();
+}
+
+void backgroundQueue::post(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    cond.notify_one();
+}
+
+void backgroundQueue::loop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
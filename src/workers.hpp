@@ -0,0 +1,63 @@
+#ifndef _ICCC_WORKERS
+#define _ICCC_WORKERS
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A small pool of threads for splitting one frame into row bands
+class workerPool
+{
+public:
+    explicit workerPool(int threads);
+    ~workerPool();
+
+    workerPool(const workerPool &) = delete;
+    workerPool &operator=(const workerPool &) = delete;
+
+    // Runs job(0), ..., job(count - 1) on the pool and the calling thread, returns when all are done
+    void run(int count, const std::function<void(int)> &job);
+
+    int size() const
+    {
+        return static_cast<int>(threads.size());
+    }
+
+private:
+    void loop();
+
+    std::vector<std::thread> threads;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stopping = false;
+};
+
+// One thread running jobs in the order they were posted, without anyone waiting for them
+class backgroundQueue
+{
+public:
+    backgroundQueue();
+    // Jobs that haven't started are dropped, the running one is finished
+    ~backgroundQueue();
+
+    backgroundQueue(const backgroundQueue &) = delete;
+    backgroundQueue &operator=(const backgroundQueue &) = delete;
+
+    void post(std::function<void()> job);
+
+private:
+    void loop();
+
+    std::thread thread;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,379 @@
+#include "yuv.hpp"
+#include "simd.hpp"
+#include "vapoursynth/VSConstants4.h"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+bool getDecodedFormat(const VSVideoFormat &format, VSVideoFormat &rgb)
+{
+    if (format.colorFamily != cfYUV || format.subSamplingW > 1 || format.subSamplingH > 1)
+        return false;
+    bool isFloat = format.sampleType == stFloat;
+    if (isFloat ? format.bitsPerSample != 32 : format.bitsPerSample > 16)
+        return false;
+    rgb = {};
+    rgb.colorFamily = cfRGB;
+    rgb.sampleType = format.sampleType;
+    rgb.bitsPerSample = format.bytesPerSample * 8;
+    rgb.bytesPerSample = format.bytesPerSample;
+    rgb.numPlanes = 3;
+    return true;
+}
+
+// Kr and Kb of the matrix, false if it isn't given by those alone
+static bool getLumaWeights(int matrix, double &kr, double &kb)
+{
+    switch (matrix)
+    {
+    case VSC_MATRIX_BT709:
+        kr = 0.2126;
+        kb = 0.0722;
+        return true;
+    case VSC_MATRIX_FCC:
+        kr = 0.30;
+        kb = 0.11;
+        return true;
+    case VSC_MATRIX_BT470_BG:
+    case VSC_MATRIX_ST170_M:
+        kr = 0.299;
+        kb = 0.114;
+        return true;
+    case VSC_MATRIX_ST240_M:
+        kr = 0.212;
+        kb = 0.087;
+        return true;
+    case VSC_MATRIX_BT2020_NCL:
+        kr = 0.2627;
+        kb = 0.0593;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isEncodableFormat(const VSVideoFormat &rgb, const VSVideoFormat &format)
+{
+    if (format.colorFamily != cfYUV || format.subSamplingW > 1 || format.subSamplingH > 1 || format.sampleType != rgb.sampleType)
+        return false;
+    if (format.sampleType == stFloat)
+        return format.bitsPerSample == 32;
+    return format.bitsPerSample >= 8 && format.bitsPerSample <= 16;
+}
+
+bool yuvDecoder::init(const VSVideoFormat &format, int width, int matrix, bool fullRange)
+{
+    double kr, kb;
+    if (!getLumaWeights(matrix, kr, kb))
+        return false;
+    double kg = 1.0 - kr - kb;
+    yt.rv = static_cast<float>(2.0 * (1.0 - kr));
+    yt.gu = static_cast<float>(2.0 * kb * (1.0 - kb) / kg);
+    yt.gv = static_cast<float>(2.0 * kr * (1.0 - kr) / kg);
+    yt.bu = static_cast<float>(2.0 * (1.0 - kb));
+
+    if (format.sampleType == stFloat)
+    {
+        // Float chroma is already centered on zero
+        yt.yOffset = 0.0f;
+        yt.yScale = 1.0f;
+        yt.cOffset = 0.0f;
+        yt.cScale = 1.0f;
+    }
+    else if (fullRange)
+    {
+        double peak = static_cast<double>((1 << format.bitsPerSample) - 1);
+        yt.yOffset = 0.0f;
+        yt.yScale = static_cast<float>(1.0 / peak);
+        yt.cOffset = static_cast<float>(1 << (format.bitsPerSample - 1));
+        yt.cScale = static_cast<float>(1.0 / peak);
+    }
+    else
+    {
+        int shift = format.bitsPerSample - 8;
+        yt.yOffset = static_cast<float>(16 << shift);
+        yt.yScale = static_cast<float>(1.0 / (219 << shift));
+        yt.cOffset = static_cast<float>(128 << shift);
+        yt.cScale = static_cast<float>(1.0 / (224 << shift));
+    }
+    yt.bytesPerSample = format.bytesPerSample;
+    yt.subSamplingW = format.subSamplingW;
+    yt.subSamplingH = format.subSamplingH;
+    yt.width = width;
+
+    // Each iteration covers two vectors of pixels, so that subsampled chroma fills one
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    simdLevel level = getSimdLevel();
+    if (level == simdLevel::avx512)
+    {
+        kernel = yuvDecode_avx512;
+        vectorWidth = 32;
+    }
+    else if (level == simdLevel::avx2)
+    {
+        kernel = yuvDecode_avx2;
+        vectorWidth = 16;
+    }
+    else if (level == simdLevel::sse41)
+    {
+        kernel = yuvDecode_sse41;
+        vectorWidth = 8;
+    }
+#endif
+    return true;
+}
+
+void yuvDecoder::decodeRow(const uint8_t * const src[3], ptrdiff_t stride, ptrdiff_t chromaStride, int y, int height, void * const dst[3]) const
+{
+    yuvRows rows;
+    rows.luma = src[0] + y * stride;
+    int nearY = y >> yt.subSamplingH;
+    // The farther chroma row for 4:2:0, the closer one weighs 3/4
+    int farY = yt.subSamplingH ? std::min(std::max(nearY + ((y & 1) ? 1 : -1), 0), (height >> 1) - 1) : nearY;
+    for (int p = 0; p < 2; ++p)
+    {
+        rows.chroma[p][0] = src[p + 1] + nearY * chromaStride;
+        rows.chroma[p][1] = src[p + 1] + farY * chromaStride;
+    }
+
+    // Subsampled kernels read one chroma sample ahead, the last one is repeated by the C kernel
+    int width = yt.width;
+    int body = kernel ? std::max(yt.subSamplingW ? width - 2 : width, 0) / vectorWidth * vectorWidth : 0;
+    if (body > 0)
+        kernel(yt, rows, dst, 0, body);
+    if (body < width)
+        yuvDecode_c(yt, rows, dst, body, width);
+}
+
+bool yuvEncoder::init(const VSVideoFormat &rgb, const VSVideoFormat &format, int matrix)
+{
+    double kr, kb;
+    if (!getLumaWeights(matrix, kr, kb))
+        return false;
+    double kg = 1.0 - kr - kb;
+
+    // Output samples per unit of Y', Cb and Cr and their offsets, input samples are scaled to [0, 1].
+    // Integer output is limited range, float output is full range.
+    double yRange = 1.0, yOffset = 0.0, cRange = 1.0, cOffset = 0.0, inScale = 1.0;
+    if (format.sampleType != stFloat)
+    {
+        int bits = format.bitsPerSample;
+        int shift = bits - 8;
+        inScale = 1.0 / ((1 << (rgb.bytesPerSample * 8)) - 1);
+        yRange = 219 << shift;
+        yOffset = 16 << shift;
+        cRange = 224 << shift;
+        cOffset = 128 << shift;
+        // Rounded by truncation after clamping
+        yOffset += 0.5;
+        cOffset += 0.5;
+        et.peak = static_cast<float>((1 << bits) - 1);
+    }
+
+    double y = yRange * inScale;
+    et.yr = static_cast<float>(kr * y);
+    et.yg = static_cast<float>(kg * y);
+    et.yb = static_cast<float>(kb * y);
+    et.yBias = static_cast<float>(yOffset);
+    // Cb = (B' - Y') / (2 - 2 Kb), Cr = (R' - Y') / (2 - 2 Kr)
+    double u = cRange * inScale / (2.0 * (1.0 - kb));
+    et.ur = static_cast<float>(-kr * u);
+    et.ug = static_cast<float>(-kg * u);
+    et.ub = static_cast<float>((1.0 - kb) * u);
+    double v = cRange * inScale / (2.0 * (1.0 - kr));
+    et.vr = static_cast<float>((1.0 - kr) * v);
+    et.vg = static_cast<float>(-kg * v);
+    et.vb = static_cast<float>(-kb * v);
+    et.cBias = static_cast<float>(cOffset);
+    et.inputBytes = rgb.bytesPerSample;
+    et.outputBytes = format.bytesPerSample;
+    et.subSamplingW = format.subSamplingW;
+    et.subSamplingH = format.subSamplingH;
+
+    kernel = nullptr;
+    vectorWidth = 1;
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+    simdLevel level = getSimdLevel();
+    if (level == simdLevel::avx512)
+    {
+        kernel = yuvEncode_avx512;
+        vectorWidth = 32;
+    }
+    else if (level == simdLevel::avx2)
+    {
+        kernel = yuvEncode_avx2;
+        vectorWidth = 16;
+    }
+    else if (level == simdLevel::sse41)
+    {
+        kernel = yuvEncode_sse41;
+        vectorWidth = 8;
+    }
+#endif
+    return true;
+}
+
+void yuvEncoder::encodeRows(const void * const rgb[2][3], uint8_t * const dst[3], ptrdiff_t stride, ptrdiff_t chromaStride, int y, int width) const
+{
+    yuvEncodeRows rows;
+    for (int p = 0; p < 3; ++p)
+    {
+        rows.rgb[0][p] = rgb[0][p];
+        rows.rgb[1][p] = et.subSamplingH ? rgb[1][p] : rgb[0][p];
+    }
+    rows.luma[0] = dst[0] + y * stride;
+    rows.luma[1] = et.subSamplingH ? dst[0] + (y + 1) * stride : nullptr;
+    for (int p = 0; p < 2; ++p)
+        rows.chroma[p] = dst[p + 1] + (y >> et.subSamplingH) * chromaStride;
+
+    // Subsampled kernels read the pixel before the first one, which is left to the C kernel at the edge
+    int left = kernel && et.subSamplingW ? 2 : 0;
+    int body = kernel ? left + std::max(width - left, 0) / vectorWidth * vectorWidth : 0;
+    if (left > 0)
+        yuvEncode_c(et, rows, 0, left);
+    if (body > left)
+        kernel(et, rows, left, body);
+    if (body < width)
+        yuvEncode_c(et, rows, body, width);
+}
+
+namespace {
+
+// Keep the operation order in sync with the SIMD kernels, so that results are identical on every CPU
+template <typename T>
+float getChroma(const yuvTable &yt, const void * const rows[2], int k)
+{
+    const T *nearRow = static_cast<const T *>(rows[0]);
+    const T *farRow = static_cast<const T *>(rows[1]);
+    if (yt.subSamplingH)
+        return (static_cast<float>(nearRow[k]) * 0.75f + static_cast<float>(farRow[k]) * 0.25f - yt.cOffset) * yt.cScale;
+    return (static_cast<float>(nearRow[k]) - yt.cOffset) * yt.cScale;
+}
+
+template <typename T>
+float upsampleChroma(const yuvTable &yt, const void * const rows[2], int x)
+{
+    if (!yt.subSamplingW)
+        return getChroma<T>(yt, rows, x);
+    int k = x >> 1;
+    if (!(x & 1))
+        return getChroma<T>(yt, rows, k);
+    int next = std::min(k + 1, (yt.width >> 1) - 1);
+    return (getChroma<T>(yt, rows, k) + getChroma<T>(yt, rows, next)) * 0.5f;
+}
+
+template <typename T>
+void store(T *dst, int x, float v)
+{
+    if (std::is_floating_point<T>::value)
+        dst[x] = static_cast<T>(v);
+    else
+    {
+        const float peak = static_cast<float>(std::numeric_limits<T>::max());
+        v = std::min(std::max(v * peak + 0.5f, 0.0f), peak);
+        dst[x] = static_cast<T>(v);
+    }
+}
+
+template <typename T>
+void decode(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    const T *luma = static_cast<const T *>(rows.luma);
+    T *r = static_cast<T *>(dst[0]);
+    T *g = static_cast<T *>(dst[1]);
+    T *b = static_cast<T *>(dst[2]);
+    for (int x = left; x < right; ++x)
+    {
+        float v = (static_cast<float>(luma[x]) - yt.yOffset) * yt.yScale;
+        float cb = upsampleChroma<T>(yt, rows.chroma[0], x);
+        float cr = upsampleChroma<T>(yt, rows.chroma[1], x);
+        store(r, x, v + yt.rv * cr);
+        store(g, x, v - yt.gu * cb - yt.gv * cr);
+        store(b, x, v + yt.bu * cb);
+    }
+}
+
+} // namespace
+
+void yuvDecode_c(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    if (yt.bytesPerSample == 4)
+        decode<float>(yt, rows, dst, left, right);
+    else if (yt.bytesPerSample == 1)
+        decode<uint8_t>(yt, rows, dst, left, right);
+    else
+        decode<uint16_t>(yt, rows, dst, left, right);
+}
+
+namespace {
+
+// Sample x of a channel, filtered with its neighbours for horizontal subsampling. The pixel before the first is
+// the first one.
+template <typename T>
+float filterChroma(const yuvEncodeTable &et, const void * const rows[2], int x)
+{
+    const T *nearRow = static_cast<const T *>(rows[0]);
+    const T *farRow = static_cast<const T *>(rows[1]);
+    auto filter = [&](const T *row)
+    {
+        if (!et.subSamplingW)
+            return static_cast<float>(row[x]);
+        float even = static_cast<float>(row[x]);
+        return (static_cast<float>(row[x > 0 ? x - 1 : 0]) + even + even + static_cast<float>(row[x + 1])) * 0.25f;
+    };
+    if (et.subSamplingH)
+        return (filter(nearRow) + filter(farRow)) * 0.5f;
+    return filter(nearRow);
+}
+
+template <typename T>
+void storeEncoded(const yuvEncodeTable &et, void *dst, int x, float v)
+{
+    if (std::is_floating_point<T>::value)
+        static_cast<T *>(dst)[x] = static_cast<T>(v);
+    else
+        static_cast<T *>(dst)[x] = static_cast<T>(std::min(std::max(v, 0.0f), et.peak));
+}
+
+template <typename Tin, typename Tout>
+void encode(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    for (int row = 0; row <= et.subSamplingH; ++row)
+    {
+        const Tin *r = static_cast<const Tin *>(rows.rgb[row][0]);
+        const Tin *g = static_cast<const Tin *>(rows.rgb[row][1]);
+        const Tin *b = static_cast<const Tin *>(rows.rgb[row][2]);
+        for (int x = left; x < right; ++x)
+            storeEncoded<Tout>(et, rows.luma[row], x, et.yr * static_cast<float>(r[x]) + et.yg * static_cast<float>(g[x]) + et.yb * static_cast<float>(b[x]) + et.yBias);
+    }
+
+    int step = 1 << et.subSamplingW;
+    for (int x = left; x < right; x += step)
+    {
+        const void *rRows[2] = {rows.rgb[0][0], rows.rgb[1][0]};
+        const void *gRows[2] = {rows.rgb[0][1], rows.rgb[1][1]};
+        const void *bRows[2] = {rows.rgb[0][2], rows.rgb[1][2]};
+        float r = filterChroma<Tin>(et, rRows, x);
+        float g = filterChroma<Tin>(et, gRows, x);
+        float b = filterChroma<Tin>(et, bRows, x);
+        int k = x >> et.subSamplingW;
+        storeEncoded<Tout>(et, rows.chroma[0], k, et.ur * r + et.ug * g + et.ub * b + et.cBias);
+        storeEncoded<Tout>(et, rows.chroma[1], k, et.vr * r + et.vg * g + et.vb * b + et.cBias);
+    }
+}
+
+} // namespace
+
+void yuvEncode_c(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    if (et.inputBytes == 4)
+        encode<float, float>(et, rows, left, right);
+    else if (et.inputBytes == 1 && et.outputBytes == 1)
+        encode<uint8_t, uint8_t>(et, rows, left, right);
+    else if (et.inputBytes == 1)
+        encode<uint8_t, uint16_t>(et, rows, left, right);
+    else if (et.outputBytes == 1)
+        encode<uint16_t, uint8_t>(et, rows, left, right);
+    else
+        encode<uint16_t, uint16_t>(et, rows, left, right);
+}
@@ -0,0 +1,51 @@
+#ifndef _ICCC_YUV
+#define _ICCC_YUV
+
+#include "common.hpp"
+#include "yuv_kernels.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Rows of a YUV frame decoded to planar R'G'B' for the transform, with range expansion, the YCbCr matrix
+// and chroma upsampling in one go. Chroma is taken as left sited, and centered vertically for 4:2:0.
+class yuvDecoder
+{
+public:
+    // False for matrices that aren't given by Kr and Kb alone
+    bool init(const VSVideoFormat &format, int width, int matrix, bool fullRange);
+
+    // Decodes row y of a frame of the given height into one row of each output plane
+    void decodeRow(const uint8_t * const src[3], ptrdiff_t stride, ptrdiff_t chromaStride, int y, int height, void * const dst[3]) const;
+
+private:
+    yuvTable yt;
+    yuvKernel kernel = nullptr;
+    int vectorWidth = 1;
+};
+
+// Rows of planar R'G'B' encoded to YUV output with the YCbCr matrix, range compression and chroma
+// downsampling in one go, sited like the chroma read by yuvDecoder.
+class yuvEncoder
+{
+public:
+    // False for matrices that aren't given by Kr and Kb alone. Integer output is limited range, float is full range.
+    bool init(const VSVideoFormat &rgb, const VSVideoFormat &format, int matrix);
+
+    // Encodes luma row y, and y + 1 for 4:2:0, with their chroma row from rows of each input plane
+    void encodeRows(const void * const rgb[2][3], uint8_t * const dst[3], ptrdiff_t stride, ptrdiff_t chromaStride, int y, int width) const;
+
+private:
+    yuvEncodeTable et;
+    yuvEncodeKernel kernel = nullptr;
+    int vectorWidth = 1;
+};
+
+// RGB format YUV input is decoded to: RGB24 for 8 bits, RGB48 for 9 to 16 bits and RGBS for float.
+// False for formats that can't be decoded.
+bool getDecodedFormat(const VSVideoFormat &format, VSVideoFormat &rgb);
+
+// YUV output of transforms to the given RGB format: the same sample type, 8 to 16 bit integer or 32 bit float,
+// subsampled at most by 2.
+bool isEncodableFormat(const VSVideoFormat &rgb, const VSVideoFormat &format);
+
+#endif
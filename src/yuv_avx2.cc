@@ -0,0 +1,273 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <immintrin.h>
+#include "yuv_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m256 loadSamples(const T *src);
+
+template <>
+__m256 loadSamples<uint8_t>(const uint8_t *src)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src))));
+}
+
+template <>
+__m256 loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src))));
+}
+
+template <>
+__m256 loadSamples<float>(const float *src)
+{
+    return _mm256_loadu_ps(src);
+}
+
+__m128i clampSamples(__m256 v, __m256 peak)
+{
+    v = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(v, peak), _mm256_set1_ps(0.5f)), _mm256_setzero_ps()), peak);
+    __m256i w = _mm256_cvttps_epi32(v);
+    return _mm_packus_epi32(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+}
+
+void storeSamples(uint8_t *dst, __m256 v, __m256 peak)
+{
+    __m128i w = clampSamples(v, peak);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(w, w));
+}
+
+void storeSamples(uint16_t *dst, __m256 v, __m256 peak)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), clampSamples(v, peak));
+}
+
+void storeSamples(float *dst, __m256 v, __m256)
+{
+    _mm256_storeu_ps(dst, v);
+}
+
+// Normalized chroma samples [k, k + 8)
+template <typename T, bool SubH>
+__m256 loadChroma(const yuvTable &yt, const T *nearRow, const T *farRow, int k)
+{
+    __m256 v = loadSamples(nearRow + k);
+    if (SubH)
+        v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(0.75f)), _mm256_mul_ps(loadSamples(farRow + k), _mm256_set1_ps(0.25f)));
+    return _mm256_mul_ps(_mm256_sub_ps(v, _mm256_set1_ps(yt.cOffset)), _mm256_set1_ps(yt.cScale));
+}
+
+// Chroma of pixels [x, x + 16), left sited samples are interleaved with the means of their neighbours
+template <typename T, bool SubW, bool SubH>
+void upsampleChroma(const yuvTable &yt, const T *nearRow, const T *farRow, int x, __m256 out[2])
+{
+    if (SubW)
+    {
+        __m256 c = loadChroma<T, SubH>(yt, nearRow, farRow, x >> 1);
+        __m256 next = loadChroma<T, SubH>(yt, nearRow, farRow, (x >> 1) + 1);
+        __m256 mean = _mm256_mul_ps(_mm256_add_ps(c, next), _mm256_set1_ps(0.5f));
+        __m256 lo = _mm256_unpacklo_ps(c, mean);
+        __m256 hi = _mm256_unpackhi_ps(c, mean);
+        out[0] = _mm256_permute2f128_ps(lo, hi, 0x20);
+        out[1] = _mm256_permute2f128_ps(lo, hi, 0x31);
+    }
+    else
+    {
+        out[0] = loadChroma<T, SubH>(yt, nearRow, farRow, x);
+        out[1] = loadChroma<T, SubH>(yt, nearRow, farRow, x + 8);
+    }
+}
+
+// Sixteen pixels per iteration, in two vectors
+template <typename T, bool SubW, bool SubH>
+void decode(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    const T *luma = static_cast<const T *>(rows.luma);
+    const T *chroma[2][2];
+    for (int p = 0; p < 2; ++p)
+    {
+        chroma[p][0] = static_cast<const T *>(rows.chroma[p][0]);
+        chroma[p][1] = static_cast<const T *>(rows.chroma[p][1]);
+    }
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const __m256 yOffset = _mm256_set1_ps(yt.yOffset);
+    const __m256 yScale = _mm256_set1_ps(yt.yScale);
+    const __m256 rv = _mm256_set1_ps(yt.rv);
+    const __m256 gu = _mm256_set1_ps(yt.gu);
+    const __m256 gv = _mm256_set1_ps(yt.gv);
+    const __m256 bu = _mm256_set1_ps(yt.bu);
+    const __m256 peak = _mm256_set1_ps(sizeof(T) == 1 ? 255.0f : 65535.0f);
+
+    for (int x = left; x < right; x += 16)
+    {
+        __m256 cb[2], cr[2];
+        upsampleChroma<T, SubW, SubH>(yt, chroma[0][0], chroma[0][1], x, cb);
+        upsampleChroma<T, SubW, SubH>(yt, chroma[1][0], chroma[1][1], x, cr);
+        for (int i = 0; i < 2; ++i)
+        {
+            int xi = x + i * 8;
+            __m256 v = _mm256_mul_ps(_mm256_sub_ps(loadSamples(luma + xi), yOffset), yScale);
+            storeSamples(dstp[0] + xi, _mm256_add_ps(v, _mm256_mul_ps(rv, cr[i])), peak);
+            storeSamples(dstp[1] + xi, _mm256_sub_ps(_mm256_sub_ps(v, _mm256_mul_ps(gu, cb[i])), _mm256_mul_ps(gv, cr[i])), peak);
+            storeSamples(dstp[2] + xi, _mm256_add_ps(v, _mm256_mul_ps(bu, cb[i])), peak);
+        }
+    }
+}
+
+template <typename T>
+void decodeSubsampled(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    if (yt.subSamplingW && yt.subSamplingH)
+        decode<T, true, true>(yt, rows, dst, left, right);
+    else if (yt.subSamplingW)
+        decode<T, true, false>(yt, rows, dst, left, right);
+    else if (yt.subSamplingH)
+        decode<T, false, true>(yt, rows, dst, left, right);
+    else
+        decode<T, false, false>(yt, rows, dst, left, right);
+}
+
+__m128i clampEncoded(__m256 v, __m256 peak)
+{
+    __m256i w = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), peak));
+    return _mm_packus_epi32(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+}
+
+void storeEncoded(uint8_t *dst, __m256 v, __m256 peak)
+{
+    __m128i w = clampEncoded(v, peak);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(w, w));
+}
+
+void storeEncoded(uint16_t *dst, __m256 v, __m256 peak)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), clampEncoded(v, peak));
+}
+
+void storeEncoded(float *dst, __m256 v, __m256)
+{
+    _mm256_storeu_ps(dst, v);
+}
+
+// Even pixels of [x, x + 16) filtered [1, 2, 1] / 4 with their neighbours
+template <typename T>
+__m256 filterRow(const T *row, int x)
+{
+    __m256 v0 = loadSamples(row + x);
+    __m256 v1 = loadSamples(row + x + 8);
+    __m256 u0 = loadSamples(row + x - 1);
+    __m256 u1 = loadSamples(row + x + 7);
+    // Shuffles pick per 128 bit lane, the 64 bit halves are put back in order
+    __m256 even = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+    __m256 next = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+    __m256 prev = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(u0, u1, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+    return _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(prev, even), even), next), _mm256_set1_ps(0.25f));
+}
+
+// One channel of 8 chroma samples, from pixels [x, x + 16) with horizontal subsampling and [x, x + 8) without
+template <typename T, bool SubW, bool SubH>
+__m256 downsampleChroma(const T *nearRow, const T *farRow, int x)
+{
+    __m256 v = SubW ? filterRow(nearRow, x) : loadSamples(nearRow + x);
+    if (SubH)
+        v = _mm256_mul_ps(_mm256_add_ps(v, SubW ? filterRow(farRow, x) : loadSamples(farRow + x)), _mm256_set1_ps(0.5f));
+    return v;
+}
+
+// 16 pixels per iteration, in two vectors
+template <typename Tin, typename Tout, bool SubW, bool SubH>
+void encode(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    const Tin *rgb[2][3];
+    for (int row = 0; row < 2; ++row)
+    {
+        for (int p = 0; p < 3; ++p)
+            rgb[row][p] = static_cast<const Tin *>(rows.rgb[row][p]);
+    }
+    Tout *luma[2] = {static_cast<Tout *>(rows.luma[0]), static_cast<Tout *>(rows.luma[1])};
+    Tout *chroma[2] = {static_cast<Tout *>(rows.chroma[0]), static_cast<Tout *>(rows.chroma[1])};
+
+    const __m256 yr = _mm256_set1_ps(et.yr);
+    const __m256 yg = _mm256_set1_ps(et.yg);
+    const __m256 yb = _mm256_set1_ps(et.yb);
+    const __m256 yBias = _mm256_set1_ps(et.yBias);
+    const __m256 ur = _mm256_set1_ps(et.ur);
+    const __m256 ug = _mm256_set1_ps(et.ug);
+    const __m256 ub = _mm256_set1_ps(et.ub);
+    const __m256 vr = _mm256_set1_ps(et.vr);
+    const __m256 vg = _mm256_set1_ps(et.vg);
+    const __m256 vb = _mm256_set1_ps(et.vb);
+    const __m256 cBias = _mm256_set1_ps(et.cBias);
+    const __m256 peak = _mm256_set1_ps(et.peak);
+
+    for (int x = left; x < right; x += 16)
+    {
+        for (int row = 0; row < (SubH ? 2 : 1); ++row)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                int xi = x + i * 8;
+                __m256 v = _mm256_add_ps(_mm256_mul_ps(yr, loadSamples(rgb[row][0] + xi)), _mm256_mul_ps(yg, loadSamples(rgb[row][1] + xi)));
+                v = _mm256_add_ps(_mm256_add_ps(v, _mm256_mul_ps(yb, loadSamples(rgb[row][2] + xi))), yBias);
+                storeEncoded(luma[row] + xi, v, peak);
+            }
+        }
+        for (int xi = x; xi < x + 16; xi += SubW ? 16 : 8)
+        {
+            __m256 r = downsampleChroma<Tin, SubW, SubH>(rgb[0][0], rgb[1][0], xi);
+            __m256 g = downsampleChroma<Tin, SubW, SubH>(rgb[0][1], rgb[1][1], xi);
+            __m256 b = downsampleChroma<Tin, SubW, SubH>(rgb[0][2], rgb[1][2], xi);
+            int k = SubW ? xi >> 1 : xi;
+            __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ur, r), _mm256_mul_ps(ug, g)), _mm256_mul_ps(ub, b)), cBias);
+            __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vr, r), _mm256_mul_ps(vg, g)), _mm256_mul_ps(vb, b)), cBias);
+            storeEncoded(chroma[0] + k, u, peak);
+            storeEncoded(chroma[1] + k, v, peak);
+        }
+    }
+}
+
+template <typename Tin, typename Tout>
+void encodeSubsampled(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    if (et.subSamplingW && et.subSamplingH)
+        encode<Tin, Tout, true, true>(et, rows, left, right);
+    else if (et.subSamplingW)
+        encode<Tin, Tout, true, false>(et, rows, left, right);
+    else if (et.subSamplingH)
+        encode<Tin, Tout, false, true>(et, rows, left, right);
+    else
+        encode<Tin, Tout, false, false>(et, rows, left, right);
+}
+
+} // namespace
+
+void yuvDecode_avx2(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    if (yt.bytesPerSample == 4)
+        decodeSubsampled<float>(yt, rows, dst, left, right);
+    else if (yt.bytesPerSample == 1)
+        decodeSubsampled<uint8_t>(yt, rows, dst, left, right);
+    else
+        decodeSubsampled<uint16_t>(yt, rows, dst, left, right);
+}
+
+void yuvEncode_avx2(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    if (et.inputBytes == 4)
+        encodeSubsampled<float, float>(et, rows, left, right);
+    else if (et.inputBytes == 1 && et.outputBytes == 1)
+        encodeSubsampled<uint8_t, uint8_t>(et, rows, left, right);
+    else if (et.inputBytes == 1)
+        encodeSubsampled<uint8_t, uint16_t>(et, rows, left, right);
+    else if (et.outputBytes == 1)
+        encodeSubsampled<uint16_t, uint8_t>(et, rows, left, right);
+    else
+        encodeSubsampled<uint16_t, uint16_t>(et, rows, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD
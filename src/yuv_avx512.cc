@@ -0,0 +1,271 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <immintrin.h>
+#include "yuv_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m512 loadSamples(const T *src);
+
+template <>
+__m512 loadSamples<uint8_t>(const uint8_t *src)
+{
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src))));
+}
+
+template <>
+__m512 loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src))));
+}
+
+template <>
+__m512 loadSamples<float>(const float *src)
+{
+    return _mm512_loadu_ps(src);
+}
+
+__m512i clampSamples(__m512 v, __m512 peak)
+{
+    v = _mm512_min_ps(_mm512_max_ps(_mm512_add_ps(_mm512_mul_ps(v, peak), _mm512_set1_ps(0.5f)), _mm512_setzero_ps()), peak);
+    return _mm512_cvttps_epi32(v);
+}
+
+void storeSamples(uint8_t *dst, __m512 v, __m512 peak)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm512_cvtepi32_epi8(clampSamples(v, peak)));
+}
+
+void storeSamples(uint16_t *dst, __m512 v, __m512 peak)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm512_cvtepi32_epi16(clampSamples(v, peak)));
+}
+
+void storeSamples(float *dst, __m512 v, __m512)
+{
+    _mm512_storeu_ps(dst, v);
+}
+
+// Normalized chroma samples [k, k + 16)
+template <typename T, bool SubH>
+__m512 loadChroma(const yuvTable &yt, const T *nearRow, const T *farRow, int k)
+{
+    __m512 v = loadSamples(nearRow + k);
+    if (SubH)
+        v = _mm512_add_ps(_mm512_mul_ps(v, _mm512_set1_ps(0.75f)), _mm512_mul_ps(loadSamples(farRow + k), _mm512_set1_ps(0.25f)));
+    return _mm512_mul_ps(_mm512_sub_ps(v, _mm512_set1_ps(yt.cOffset)), _mm512_set1_ps(yt.cScale));
+}
+
+// Chroma of pixels [x, x + 32), left sited samples are interleaved with the means of their neighbours
+template <typename T, bool SubW, bool SubH>
+void upsampleChroma(const yuvTable &yt, const T *nearRow, const T *farRow, int x, __m512 out[2])
+{
+    if (SubW)
+    {
+        __m512 c = loadChroma<T, SubH>(yt, nearRow, farRow, x >> 1);
+        __m512 next = loadChroma<T, SubH>(yt, nearRow, farRow, (x >> 1) + 1);
+        __m512 mean = _mm512_mul_ps(_mm512_add_ps(c, next), _mm512_set1_ps(0.5f));
+        // Pairs come out per 128 bit lane, lo holds the first half of each
+        __m512 lo = _mm512_unpacklo_ps(c, mean);
+        __m512 hi = _mm512_unpackhi_ps(c, mean);
+        out[0] = _mm512_permutex2var_ps(lo, _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 18, 19, 4, 5, 6, 7, 20, 21, 22, 23), hi);
+        out[1] = _mm512_permutex2var_ps(lo, _mm512_setr_epi32(8, 9, 10, 11, 24, 25, 26, 27, 12, 13, 14, 15, 28, 29, 30, 31), hi);
+    }
+    else
+    {
+        out[0] = loadChroma<T, SubH>(yt, nearRow, farRow, x);
+        out[1] = loadChroma<T, SubH>(yt, nearRow, farRow, x + 16);
+    }
+}
+
+// 32 pixels per iteration, in two vectors
+template <typename T, bool SubW, bool SubH>
+void decode(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    const T *luma = static_cast<const T *>(rows.luma);
+    const T *chroma[2][2];
+    for (int p = 0; p < 2; ++p)
+    {
+        chroma[p][0] = static_cast<const T *>(rows.chroma[p][0]);
+        chroma[p][1] = static_cast<const T *>(rows.chroma[p][1]);
+    }
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const __m512 yOffset = _mm512_set1_ps(yt.yOffset);
+    const __m512 yScale = _mm512_set1_ps(yt.yScale);
+    const __m512 rv = _mm512_set1_ps(yt.rv);
+    const __m512 gu = _mm512_set1_ps(yt.gu);
+    const __m512 gv = _mm512_set1_ps(yt.gv);
+    const __m512 bu = _mm512_set1_ps(yt.bu);
+    const __m512 peak = _mm512_set1_ps(sizeof(T) == 1 ? 255.0f : 65535.0f);
+
+    for (int x = left; x < right; x += 32)
+    {
+        __m512 cb[2], cr[2];
+        upsampleChroma<T, SubW, SubH>(yt, chroma[0][0], chroma[0][1], x, cb);
+        upsampleChroma<T, SubW, SubH>(yt, chroma[1][0], chroma[1][1], x, cr);
+        for (int i = 0; i < 2; ++i)
+        {
+            int xi = x + i * 16;
+            __m512 v = _mm512_mul_ps(_mm512_sub_ps(loadSamples(luma + xi), yOffset), yScale);
+            storeSamples(dstp[0] + xi, _mm512_add_ps(v, _mm512_mul_ps(rv, cr[i])), peak);
+            storeSamples(dstp[1] + xi, _mm512_sub_ps(_mm512_sub_ps(v, _mm512_mul_ps(gu, cb[i])), _mm512_mul_ps(gv, cr[i])), peak);
+            storeSamples(dstp[2] + xi, _mm512_add_ps(v, _mm512_mul_ps(bu, cb[i])), peak);
+        }
+    }
+}
+
+template <typename T>
+void decodeSubsampled(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    if (yt.subSamplingW && yt.subSamplingH)
+        decode<T, true, true>(yt, rows, dst, left, right);
+    else if (yt.subSamplingW)
+        decode<T, true, false>(yt, rows, dst, left, right);
+    else if (yt.subSamplingH)
+        decode<T, false, true>(yt, rows, dst, left, right);
+    else
+        decode<T, false, false>(yt, rows, dst, left, right);
+}
+
+__m512i clampEncoded(__m512 v, __m512 peak)
+{
+    return _mm512_cvttps_epi32(_mm512_min_ps(_mm512_max_ps(v, _mm512_setzero_ps()), peak));
+}
+
+void storeEncoded(uint8_t *dst, __m512 v, __m512 peak)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm512_cvtepi32_epi8(clampEncoded(v, peak)));
+}
+
+void storeEncoded(uint16_t *dst, __m512 v, __m512 peak)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm512_cvtepi32_epi16(clampEncoded(v, peak)));
+}
+
+void storeEncoded(float *dst, __m512 v, __m512)
+{
+    _mm512_storeu_ps(dst, v);
+}
+
+// Even pixels of [x, x + 32) filtered [1, 2, 1] / 4 with their neighbours
+template <typename T>
+__m512 filterRow(const T *row, int x)
+{
+    __m512 v0 = loadSamples(row + x);
+    __m512 v1 = loadSamples(row + x + 16);
+    __m512 u0 = loadSamples(row + x - 1);
+    __m512 u1 = loadSamples(row + x + 15);
+    const __m512i evenIndex = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i oddIndex = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    __m512 even = _mm512_permutex2var_ps(v0, evenIndex, v1);
+    __m512 next = _mm512_permutex2var_ps(v0, oddIndex, v1);
+    __m512 prev = _mm512_permutex2var_ps(u0, evenIndex, u1);
+    return _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(_mm512_add_ps(prev, even), even), next), _mm512_set1_ps(0.25f));
+}
+
+// One channel of 16 chroma samples, from pixels [x, x + 32) with horizontal subsampling and [x, x + 16) without
+template <typename T, bool SubW, bool SubH>
+__m512 downsampleChroma(const T *nearRow, const T *farRow, int x)
+{
+    __m512 v = SubW ? filterRow(nearRow, x) : loadSamples(nearRow + x);
+    if (SubH)
+        v = _mm512_mul_ps(_mm512_add_ps(v, SubW ? filterRow(farRow, x) : loadSamples(farRow + x)), _mm512_set1_ps(0.5f));
+    return v;
+}
+
+// 32 pixels per iteration, in two vectors
+template <typename Tin, typename Tout, bool SubW, bool SubH>
+void encode(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    const Tin *rgb[2][3];
+    for (int row = 0; row < 2; ++row)
+    {
+        for (int p = 0; p < 3; ++p)
+            rgb[row][p] = static_cast<const Tin *>(rows.rgb[row][p]);
+    }
+    Tout *luma[2] = {static_cast<Tout *>(rows.luma[0]), static_cast<Tout *>(rows.luma[1])};
+    Tout *chroma[2] = {static_cast<Tout *>(rows.chroma[0]), static_cast<Tout *>(rows.chroma[1])};
+
+    const __m512 yr = _mm512_set1_ps(et.yr);
+    const __m512 yg = _mm512_set1_ps(et.yg);
+    const __m512 yb = _mm512_set1_ps(et.yb);
+    const __m512 yBias = _mm512_set1_ps(et.yBias);
+    const __m512 ur = _mm512_set1_ps(et.ur);
+    const __m512 ug = _mm512_set1_ps(et.ug);
+    const __m512 ub = _mm512_set1_ps(et.ub);
+    const __m512 vr = _mm512_set1_ps(et.vr);
+    const __m512 vg = _mm512_set1_ps(et.vg);
+    const __m512 vb = _mm512_set1_ps(et.vb);
+    const __m512 cBias = _mm512_set1_ps(et.cBias);
+    const __m512 peak = _mm512_set1_ps(et.peak);
+
+    for (int x = left; x < right; x += 32)
+    {
+        for (int row = 0; row < (SubH ? 2 : 1); ++row)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                int xi = x + i * 16;
+                __m512 v = _mm512_add_ps(_mm512_mul_ps(yr, loadSamples(rgb[row][0] + xi)), _mm512_mul_ps(yg, loadSamples(rgb[row][1] + xi)));
+                v = _mm512_add_ps(_mm512_add_ps(v, _mm512_mul_ps(yb, loadSamples(rgb[row][2] + xi))), yBias);
+                storeEncoded(luma[row] + xi, v, peak);
+            }
+        }
+        for (int xi = x; xi < x + 32; xi += SubW ? 32 : 16)
+        {
+            __m512 r = downsampleChroma<Tin, SubW, SubH>(rgb[0][0], rgb[1][0], xi);
+            __m512 g = downsampleChroma<Tin, SubW, SubH>(rgb[0][1], rgb[1][1], xi);
+            __m512 b = downsampleChroma<Tin, SubW, SubH>(rgb[0][2], rgb[1][2], xi);
+            int k = SubW ? xi >> 1 : xi;
+            __m512 u = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ur, r), _mm512_mul_ps(ug, g)), _mm512_mul_ps(ub, b)), cBias);
+            __m512 v = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(vr, r), _mm512_mul_ps(vg, g)), _mm512_mul_ps(vb, b)), cBias);
+            storeEncoded(chroma[0] + k, u, peak);
+            storeEncoded(chroma[1] + k, v, peak);
+        }
+    }
+}
+
+template <typename Tin, typename Tout>
+void encodeSubsampled(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    if (et.subSamplingW && et.subSamplingH)
+        encode<Tin, Tout, true, true>(et, rows, left, right);
+    else if (et.subSamplingW)
+        encode<Tin, Tout, true, false>(et, rows, left, right);
+    else if (et.subSamplingH)
+        encode<Tin, Tout, false, true>(et, rows, left, right);
+    else
+        encode<Tin, Tout, false, false>(et, rows, left, right);
+}
+
+} // namespace
+
+void yuvDecode_avx512(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    if (yt.bytesPerSample == 4)
+        decodeSubsampled<float>(yt, rows, dst, left, right);
+    else if (yt.bytesPerSample == 1)
+        decodeSubsampled<uint8_t>(yt, rows, dst, left, right);
+    else
+        decodeSubsampled<uint16_t>(yt, rows, dst, left, right);
+}
+
+void yuvEncode_avx512(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    if (et.inputBytes == 4)
+        encodeSubsampled<float, float>(et, rows, left, right);
+    else if (et.inputBytes == 1 && et.outputBytes == 1)
+        encodeSubsampled<uint8_t, uint8_t>(et, rows, left, right);
+    else if (et.inputBytes == 1)
+        encodeSubsampled<uint8_t, uint16_t>(et, rows, left, right);
+    else if (et.outputBytes == 1)
+        encodeSubsampled<uint16_t, uint8_t>(et, rows, left, right);
+    else
+        encodeSubsampled<uint16_t, uint16_t>(et, rows, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD
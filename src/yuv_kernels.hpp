@@ -0,0 +1,91 @@
+#ifndef _ICCC_YUV_KERNELS
+#define _ICCC_YUV_KERNELS
+
+#include <cstddef>
+#include <cstdint>
+
+// Range expansion and YCbCr matrix of YUV input, decoded to R'G'B' with the same sample size
+struct yuvTable
+{
+    // Samples are normalized as (v - offset) * scale, to [0, 1] for Y' and [-0.5, 0.5] for Cb and Cr
+    float yOffset = 0.0f;
+    float yScale = 1.0f;
+    float cOffset = 0.0f;
+    float cScale = 1.0f;
+    // R' = Y' + rv * Cr, G' = Y' - gu * Cb - gv * Cr, B' = Y' + bu * Cb
+    float rv = 0.0f;
+    float gu = 0.0f;
+    float gv = 0.0f;
+    float bu = 0.0f;
+    // 4 for float
+    int bytesPerSample = 0;
+    int subSamplingW = 0;
+    int subSamplingH = 0;
+    // Luma width of the frame
+    int width = 0;
+};
+
+// Source rows of one output row. 4:2:0 chroma is blended 3:1 from the nearer and the farther row.
+struct yuvRows
+{
+    const void *luma;
+    // [Cb, Cr][near, far]
+    const void *chroma[2][2];
+};
+
+// Decodes pixels [left, right) of one row into planar R'G'B'. Chroma is left sited, so odd pixels take
+// the mean of the samples on both sides. SIMD kernels require right - left to be a multiple of their
+// vector width, and with horizontal subsampling they read one chroma sample past right / 2.
+typedef void (*yuvKernel)(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right);
+
+void yuvDecode_c(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right);
+void yuvDecode_sse41(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right);
+void yuvDecode_avx2(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right);
+void yuvDecode_avx512(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right);
+
+// YCbCr matrix and range compression of YUV output, from planar R'G'B' of the transform
+struct yuvEncodeTable
+{
+    // Y' = yr * R' + yg * G' + yb * B' + yBias in output samples, from input samples. Cb and Cr alike.
+    float yr = 0.0f;
+    float yg = 0.0f;
+    float yb = 0.0f;
+    float yBias = 0.0f;
+    float ur = 0.0f;
+    float ug = 0.0f;
+    float ub = 0.0f;
+    float vr = 0.0f;
+    float vg = 0.0f;
+    float vb = 0.0f;
+    float cBias = 0.0f;
+    // Integer output is clamped to [0, peak], the biases include the rounding
+    float peak = 0.0f;
+    // 4 for float
+    int inputBytes = 0;
+    int outputBytes = 0;
+    int subSamplingW = 0;
+    int subSamplingH = 0;
+};
+
+// Rows of one chroma row, two of each for 4:2:0 where the second pair is ignored otherwise
+struct yuvEncodeRows
+{
+    // [row][R, G, B]
+    const void *rgb[2][3];
+    void *luma[2];
+    // Cb, Cr
+    void *chroma[2];
+};
+
+// Encodes pixels [left, right) of one chroma row. Chroma is left sited, each sample filtered [1, 2, 1] / 4
+// across the pixels around it, and 4:2:0 rows are averaged. SIMD kernels require right - left to be a
+// multiple of their vector width, and with horizontal subsampling they read the pixel before left.
+// The width is even with horizontal subsampling, so the pixel after each sample is always there.
+typedef void (*yuvEncodeKernel)(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right);
+
+void yuvEncode_c(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right);
+void yuvEncode_sse41(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right);
+void yuvEncode_avx2(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right);
+void yuvEncode_avx512(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right);
+
+#endif
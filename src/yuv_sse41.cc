@@ -0,0 +1,270 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <cstring>
+#include <smmintrin.h>
+#include "yuv_kernels.hpp"
+
+namespace {
+
+template <typename T>
+__m128 loadSamples(const T *src);
+
+template <>
+__m128 loadSamples<uint8_t>(const uint8_t *src)
+{
+    int32_t v;
+    memcpy(&v, src, sizeof(v));
+    return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(v)));
+}
+
+template <>
+__m128 loadSamples<uint16_t>(const uint16_t *src)
+{
+    return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src))));
+}
+
+template <>
+__m128 loadSamples<float>(const float *src)
+{
+    return _mm_loadu_ps(src);
+}
+
+void storeSamples(uint8_t *dst, __m128 v, __m128 peak)
+{
+    v = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v, peak), _mm_set1_ps(0.5f)), _mm_setzero_ps()), peak);
+    __m128i w = _mm_cvttps_epi32(v);
+    w = _mm_packus_epi32(w, w);
+    w = _mm_packus_epi16(w, w);
+    int32_t out = _mm_cvtsi128_si32(w);
+    memcpy(dst, &out, sizeof(out));
+}
+
+void storeSamples(uint16_t *dst, __m128 v, __m128 peak)
+{
+    v = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v, peak), _mm_set1_ps(0.5f)), _mm_setzero_ps()), peak);
+    __m128i w = _mm_cvttps_epi32(v);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi32(w, w));
+}
+
+void storeSamples(float *dst, __m128 v, __m128)
+{
+    _mm_storeu_ps(dst, v);
+}
+
+// Normalized chroma samples [k, k + 4)
+template <typename T, bool SubH>
+__m128 loadChroma(const yuvTable &yt, const T *nearRow, const T *farRow, int k)
+{
+    __m128 v = loadSamples(nearRow + k);
+    if (SubH)
+        v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(0.75f)), _mm_mul_ps(loadSamples(farRow + k), _mm_set1_ps(0.25f)));
+    return _mm_mul_ps(_mm_sub_ps(v, _mm_set1_ps(yt.cOffset)), _mm_set1_ps(yt.cScale));
+}
+
+// Chroma of pixels [x, x + 8), left sited samples are interleaved with the means of their neighbours
+template <typename T, bool SubW, bool SubH>
+void upsampleChroma(const yuvTable &yt, const T *nearRow, const T *farRow, int x, __m128 out[2])
+{
+    if (SubW)
+    {
+        __m128 c = loadChroma<T, SubH>(yt, nearRow, farRow, x >> 1);
+        __m128 next = loadChroma<T, SubH>(yt, nearRow, farRow, (x >> 1) + 1);
+        __m128 mean = _mm_mul_ps(_mm_add_ps(c, next), _mm_set1_ps(0.5f));
+        out[0] = _mm_unpacklo_ps(c, mean);
+        out[1] = _mm_unpackhi_ps(c, mean);
+    }
+    else
+    {
+        out[0] = loadChroma<T, SubH>(yt, nearRow, farRow, x);
+        out[1] = loadChroma<T, SubH>(yt, nearRow, farRow, x + 4);
+    }
+}
+
+// Eight pixels per iteration, in two vectors
+template <typename T, bool SubW, bool SubH>
+void decode(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    const T *luma = static_cast<const T *>(rows.luma);
+    const T *chroma[2][2];
+    for (int p = 0; p < 2; ++p)
+    {
+        chroma[p][0] = static_cast<const T *>(rows.chroma[p][0]);
+        chroma[p][1] = static_cast<const T *>(rows.chroma[p][1]);
+    }
+    T *dstp[3] = {static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2])};
+
+    const __m128 yOffset = _mm_set1_ps(yt.yOffset);
+    const __m128 yScale = _mm_set1_ps(yt.yScale);
+    const __m128 rv = _mm_set1_ps(yt.rv);
+    const __m128 gu = _mm_set1_ps(yt.gu);
+    const __m128 gv = _mm_set1_ps(yt.gv);
+    const __m128 bu = _mm_set1_ps(yt.bu);
+    const __m128 peak = _mm_set1_ps(sizeof(T) == 1 ? 255.0f : 65535.0f);
+
+    for (int x = left; x < right; x += 8)
+    {
+        __m128 cb[2], cr[2];
+        upsampleChroma<T, SubW, SubH>(yt, chroma[0][0], chroma[0][1], x, cb);
+        upsampleChroma<T, SubW, SubH>(yt, chroma[1][0], chroma[1][1], x, cr);
+        for (int i = 0; i < 2; ++i)
+        {
+            int xi = x + i * 4;
+            __m128 v = _mm_mul_ps(_mm_sub_ps(loadSamples(luma + xi), yOffset), yScale);
+            storeSamples(dstp[0] + xi, _mm_add_ps(v, _mm_mul_ps(rv, cr[i])), peak);
+            storeSamples(dstp[1] + xi, _mm_sub_ps(_mm_sub_ps(v, _mm_mul_ps(gu, cb[i])), _mm_mul_ps(gv, cr[i])), peak);
+            storeSamples(dstp[2] + xi, _mm_add_ps(v, _mm_mul_ps(bu, cb[i])), peak);
+        }
+    }
+}
+
+template <typename T>
+void decodeSubsampled(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    if (yt.subSamplingW && yt.subSamplingH)
+        decode<T, true, true>(yt, rows, dst, left, right);
+    else if (yt.subSamplingW)
+        decode<T, true, false>(yt, rows, dst, left, right);
+    else if (yt.subSamplingH)
+        decode<T, false, true>(yt, rows, dst, left, right);
+    else
+        decode<T, false, false>(yt, rows, dst, left, right);
+}
+
+void storeEncoded(uint8_t *dst, __m128 v, __m128 peak)
+{
+    __m128i w = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), peak));
+    w = _mm_packus_epi32(w, w);
+    w = _mm_packus_epi16(w, w);
+    int32_t out = _mm_cvtsi128_si32(w);
+    memcpy(dst, &out, sizeof(out));
+}
+
+void storeEncoded(uint16_t *dst, __m128 v, __m128 peak)
+{
+    __m128i w = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), peak));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi32(w, w));
+}
+
+void storeEncoded(float *dst, __m128 v, __m128)
+{
+    _mm_storeu_ps(dst, v);
+}
+
+// Even pixels of [x, x + 8) filtered [1, 2, 1] / 4 with their neighbours
+template <typename T>
+__m128 filterRow(const T *row, int x)
+{
+    __m128 v0 = loadSamples(row + x);
+    __m128 v1 = loadSamples(row + x + 4);
+    __m128 u0 = loadSamples(row + x - 1);
+    __m128 u1 = loadSamples(row + x + 3);
+    __m128 even = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 next = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+    __m128 prev = _mm_shuffle_ps(u0, u1, _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(prev, even), even), next), _mm_set1_ps(0.25f));
+}
+
+// One channel of four chroma samples, from pixels [x, x + 8) with horizontal subsampling and [x, x + 4) without
+template <typename T, bool SubW, bool SubH>
+__m128 downsampleChroma(const T *nearRow, const T *farRow, int x)
+{
+    __m128 v = SubW ? filterRow(nearRow, x) : loadSamples(nearRow + x);
+    if (SubH)
+        v = _mm_mul_ps(_mm_add_ps(v, SubW ? filterRow(farRow, x) : loadSamples(farRow + x)), _mm_set1_ps(0.5f));
+    return v;
+}
+
+// Eight pixels per iteration, in two vectors
+template <typename Tin, typename Tout, bool SubW, bool SubH>
+void encode(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    const Tin *rgb[2][3];
+    for (int row = 0; row < 2; ++row)
+    {
+        for (int p = 0; p < 3; ++p)
+            rgb[row][p] = static_cast<const Tin *>(rows.rgb[row][p]);
+    }
+    Tout *luma[2] = {static_cast<Tout *>(rows.luma[0]), static_cast<Tout *>(rows.luma[1])};
+    Tout *chroma[2] = {static_cast<Tout *>(rows.chroma[0]), static_cast<Tout *>(rows.chroma[1])};
+
+    const __m128 yr = _mm_set1_ps(et.yr);
+    const __m128 yg = _mm_set1_ps(et.yg);
+    const __m128 yb = _mm_set1_ps(et.yb);
+    const __m128 yBias = _mm_set1_ps(et.yBias);
+    const __m128 ur = _mm_set1_ps(et.ur);
+    const __m128 ug = _mm_set1_ps(et.ug);
+    const __m128 ub = _mm_set1_ps(et.ub);
+    const __m128 vr = _mm_set1_ps(et.vr);
+    const __m128 vg = _mm_set1_ps(et.vg);
+    const __m128 vb = _mm_set1_ps(et.vb);
+    const __m128 cBias = _mm_set1_ps(et.cBias);
+    const __m128 peak = _mm_set1_ps(et.peak);
+
+    for (int x = left; x < right; x += 8)
+    {
+        for (int row = 0; row < (SubH ? 2 : 1); ++row)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                int xi = x + i * 4;
+                __m128 v = _mm_add_ps(_mm_mul_ps(yr, loadSamples(rgb[row][0] + xi)), _mm_mul_ps(yg, loadSamples(rgb[row][1] + xi)));
+                v = _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(yb, loadSamples(rgb[row][2] + xi))), yBias);
+                storeEncoded(luma[row] + xi, v, peak);
+            }
+        }
+        for (int xi = x; xi < x + 8; xi += SubW ? 8 : 4)
+        {
+            __m128 r = downsampleChroma<Tin, SubW, SubH>(rgb[0][0], rgb[1][0], xi);
+            __m128 g = downsampleChroma<Tin, SubW, SubH>(rgb[0][1], rgb[1][1], xi);
+            __m128 b = downsampleChroma<Tin, SubW, SubH>(rgb[0][2], rgb[1][2], xi);
+            int k = SubW ? xi >> 1 : xi;
+            __m128 u = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ur, r), _mm_mul_ps(ug, g)), _mm_mul_ps(ub, b)), cBias);
+            __m128 v = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, r), _mm_mul_ps(vg, g)), _mm_mul_ps(vb, b)), cBias);
+            storeEncoded(chroma[0] + k, u, peak);
+            storeEncoded(chroma[1] + k, v, peak);
+        }
+    }
+}
+
+template <typename Tin, typename Tout>
+void encodeSubsampled(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    if (et.subSamplingW && et.subSamplingH)
+        encode<Tin, Tout, true, true>(et, rows, left, right);
+    else if (et.subSamplingW)
+        encode<Tin, Tout, true, false>(et, rows, left, right);
+    else if (et.subSamplingH)
+        encode<Tin, Tout, false, true>(et, rows, left, right);
+    else
+        encode<Tin, Tout, false, false>(et, rows, left, right);
+}
+
+} // namespace
+
+void yuvDecode_sse41(const yuvTable &yt, const yuvRows &rows, void * const dst[3], int left, int right)
+{
+    if (yt.bytesPerSample == 4)
+        decodeSubsampled<float>(yt, rows, dst, left, right);
+    else if (yt.bytesPerSample == 1)
+        decodeSubsampled<uint8_t>(yt, rows, dst, left, right);
+    else
+        decodeSubsampled<uint16_t>(yt, rows, dst, left, right);
+}
+
+void yuvEncode_sse41(const yuvEncodeTable &et, const yuvEncodeRows &rows, int left, int right)
+{
+    if (et.inputBytes == 4)
+        encodeSubsampled<float, float>(et, rows, left, right);
+    else if (et.inputBytes == 1 && et.outputBytes == 1)
+        encodeSubsampled<uint8_t, uint8_t>(et, rows, left, right);
+    else if (et.inputBytes == 1)
+        encodeSubsampled<uint8_t, uint16_t>(et, rows, left, right);
+    else if (et.outputBytes == 1)
+        encodeSubsampled<uint16_t, uint8_t>(et, rows, left, right);
+    else
+        encodeSubsampled<uint16_t, uint16_t>(et, rows, left, right);
+}
+
+#endif // x86
+#endif // P2P_SIMD